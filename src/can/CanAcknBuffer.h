@@ -0,0 +1,232 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2017 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAN_ACKN_BUFFER_H_
+#define CAN_ACKN_BUFFER_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+
+#ifdef SCONS_TARGET_LINUX
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "CanMessage.h"
+
+/**
+ * Thread-safe buffer of transmit acknowledgments (confirmed messages).
+ * Messages are retrieved in order of confirmation, or by their transaction id,
+ * which is looked up in constant time regardless of the number of outstanding
+ * transmissions. When full, the oldest acknowledgment is discarded.
+ *
+ * On Linux, an eventfd can be obtained that is readable whenever
+ * acknowledgments are available.
+ */
+class CanAcknBuffer {
+public:
+	CanAcknBuffer(std::size_t aMaxEntries = 4096) :
+			mMutex(), mNotifier(), mMaxEntries(aMaxEntries), mFirstSeq(0), mNumAvailable(0),
+			mEventFd(-1), mSignaled(false) {
+		mNextTransactionSeq = 0;
+	}
+
+	~CanAcknBuffer(){
+#ifdef SCONS_TARGET_LINUX
+		if(mEventFd >= 0){
+			::close(mEventFd);
+		}
+#endif
+	};
+
+	/**
+	 * Reserves aCount consecutive transaction ids.
+	 * Ids cycle through 1..65535, 0 being reserved for "any transaction".
+	 * @return first transaction id, use getTransactionId() for the following ones
+	 */
+	uint16_t allocateTransactionIds(std::size_t aCount){
+		return (uint16_t)(mNextTransactionSeq.fetch_add((uint32_t)aCount) % 65535 + 1);
+	}
+
+	static uint16_t getTransactionId(uint16_t aFirstTransactionId, std::size_t aOffset){
+		return (uint16_t)((aFirstTransactionId - 1 + aOffset) % 65535 + 1);
+	}
+
+	void push(const CanMessage &aMsg){
+		pushMany(&aMsg, 1);
+	}
+
+	void pushMany(const CanMessage *aMsgs, std::size_t aCount){
+		if(aCount == 0){
+			return;
+		}
+		boost::mutex::scoped_lock lock(mMutex);
+		for(std::size_t i=0; i<aCount; i++){
+			if(mEntries.size() == mMaxEntries){
+				discardOldest();
+			}
+			uint64_t seq = mFirstSeq + mEntries.size();
+			mEntries.push_back(Entry(aMsgs[i]));
+			mNumAvailable++;
+			if(aMsgs[i].getTransactionId() != 0){
+				mIndex[aMsgs[i].getTransactionId()] = seq;
+			}
+		}
+		updateEvent();
+		lock.unlock();
+		mNotifier.notify_all();
+	}
+
+	/**
+	 * Retrieves acknowledgment.
+	 * @param aMsg object to store acknowledged message
+	 * @param aTransactionId transaction to wait for (0: oldest acknowledgment)
+	 * @param aTimeoutMs time to wait
+	 * @return true when valid message is returned
+	 */
+	bool pop(CanMessage &aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
+		boost::mutex::scoped_lock lock(mMutex);
+		if(aTransactionId == 0){
+			if(!mNotifier.timed_wait(lock, boost::posix_time::milliseconds(aTimeoutMs),
+					boost::bind(&CanAcknBuffer::isNotEmpty, this))){
+				return false;
+			}
+			while(mEntries.front().mTaken){
+				discardOldest();
+			}
+			aMsg = mEntries.front().mMsg;
+			discardOldest();
+			updateEvent();
+			return true;
+		}
+
+		if(!mNotifier.timed_wait(lock, boost::posix_time::milliseconds(aTimeoutMs),
+				boost::bind(&CanAcknBuffer::isAcknowledged, this, aTransactionId))){
+			return false;
+		}
+		Index::iterator it = mIndex.find(aTransactionId);
+		Entry &e = mEntries[it->second - mFirstSeq];
+		aMsg = e.mMsg;
+		e.mTaken = true;
+		mNumAvailable--;
+		mIndex.erase(it);
+		updateEvent();
+		return true;
+	}
+
+	int32_t available() const{
+		boost::mutex::scoped_lock lock(mMutex);
+		return (int32_t)mNumAvailable;
+	}
+
+	void clear(){
+		boost::mutex::scoped_lock lock(mMutex);
+		mFirstSeq += mEntries.size();
+		mEntries.clear();
+		mIndex.clear();
+		mNumAvailable = 0;
+		updateEvent();
+	}
+
+	/**
+	 * Returns descriptor which is readable while acknowledgments are available.
+	 * The descriptor remains owned by the buffer.
+	 * @return file descriptor, -1 if not supported
+	 */
+	int getEventFd(){
+#ifdef SCONS_TARGET_LINUX
+		boost::mutex::scoped_lock lock(mMutex);
+		if(mEventFd < 0){
+			mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			updateEvent();
+		}
+		return mEventFd;
+#else
+		return -1;
+#endif
+	}
+
+private:
+	struct Entry {
+		Entry(const CanMessage &aMsg) : mMsg(aMsg), mTaken(false) {};
+		CanMessage mMsg;
+		bool mTaken; // already retrieved by transaction id
+	};
+	typedef boost::unordered_map<uint16_t, uint64_t> Index; // transaction id -> sequence number
+
+	bool isNotEmpty(){
+		return (mNumAvailable != 0);
+	}
+
+	bool isAcknowledged(uint16_t aTransactionId){
+		return (mIndex.find(aTransactionId) != mIndex.end());
+	}
+
+	// removes entry at front, must be called with lock held
+	void discardOldest(){
+		Entry &e = mEntries.front();
+		if(!e.mTaken){
+			mNumAvailable--;
+			Index::iterator it = mIndex.find(e.mMsg.getTransactionId());
+			if((it != mIndex.end()) && (it->second == mFirstSeq)){
+				mIndex.erase(it);
+			}
+		}
+		mEntries.pop_front();
+		mFirstSeq++;
+	}
+
+	// keeps descriptor readable while acknowledgments are available, must be called with lock held
+	void updateEvent(){
+#ifdef SCONS_TARGET_LINUX
+		if(mEventFd < 0){
+			return;
+		}
+		if((mNumAvailable != 0) && !mSignaled){
+			eventfd_write(mEventFd, 1);
+			mSignaled = true;
+		} else if((mNumAvailable == 0) && mSignaled){
+			eventfd_t value;
+			eventfd_read(mEventFd, &value);
+			mSignaled = false;
+		}
+#endif
+	}
+
+	mutable boost::mutex mMutex;
+	boost::condition_variable mNotifier;
+	std::size_t mMaxEntries;
+	std::deque<Entry> mEntries;
+	uint64_t mFirstSeq; // sequence number of mEntries.front()
+	Index mIndex;
+	std::size_t mNumAvailable;
+	boost::atomic<uint32_t> mNextTransactionSeq;
+	int mEventFd;
+	bool mSignaled;
+};
+
+#endif /* CAN_ACKN_BUFFER_H_ */
@@ -25,7 +25,9 @@
 #include <stdint.h>
 #endif
 
+#include <vector>
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
 
 #include "CanPort.h"
 
@@ -52,6 +54,13 @@ public:
 		NiXnetCan = 9
 	};
 
+	/**
+	 * Receive callback, invoked from the adapter's receive thread with a batch of
+	 * received messages, which are only valid for the duration of the call.
+	 * The callback must not block, and must not call back into the adapter.
+	 */
+	typedef boost::function<void (const CanMessage *aMsgs, std::size_t aCount)> ReceiveCallback;
+
 	enum CanAdapterState {
 		Unknown = -1,
 		Closed = 0,
@@ -68,11 +77,24 @@ public:
 	CanAdapter() {};
 	virtual ~CanAdapter() {};
 
+	// shared pointer variants (see CanPort)
+	using CanPort::sendMessage;
+	using CanPort::getReceivedMessage;
+	using CanPort::getSendAcknMessage;
+
 	/**
 	 * Sets generic parameter.
 	 */
 	virtual bool setParameter(std::string aKey, std::string aValue) = 0;
 
+	/**
+	 * Gets generic parameter, such as adapter statistics.
+	 * @param aKey parameter name
+	 * @param aValue string to which value is written
+	 * @return true if parameter is supported
+	 */
+	virtual bool getParameter(std::string aKey, std::string &aValue) = 0;
+
 	/**
 	 * Sets baud-rate.
 	 * @param baudrate baudrate
@@ -128,7 +150,19 @@ public:
 	 * @param aTransactionId id associated with transmission (set to nullptr if not used)
 	 * @return true if successful
 	 */
-	virtual bool sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId) = 0;
+	virtual bool sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId) = 0;
+
+	/**
+	 * Send several messages.
+	 * Queues CAN messages into transmit buffer, in order, handing them over
+	 * to the adapter as a batch. Transaction ids are assigned consecutively,
+	 * starting with the id returned for the first message.
+	 *
+	 * @param aMsgs CAN messages
+	 * @param aFirstTransactionId id associated with transmission of first message (set to nullptr if not used)
+	 * @return number of messages queued
+	 */
+	virtual int sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId) = 0;
 
 	/**
 	 * Get number of messages in receive buffer.
@@ -144,7 +178,55 @@ public:
 	 * @param aTimeoutMs time to wait for received message
 	 * @return true when valid message is returned by function
 	 */
-	virtual bool getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs) = 0;
+	virtual bool getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs) = 0;
+
+	/**
+	 * Retrieve several messages from receive buffer.
+	 * Blocks until at least one message is available, or the timeout expires,
+	 * and then returns all messages available up to the specified maximum.
+	 *
+	 * @param aMsgs vector to store received messages (resized to number of messages retrieved)
+	 * @param aMaxMsgs maximum number of messages to retrieve
+	 * @param aTimeoutMs time to wait for received message
+	 * @return number of messages retrieved
+	 */
+	virtual int getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs) = 0;
+
+	/**
+	 * Retrieve message with matching id from receive buffer.
+	 * Messages that do not match remain in the receive buffer, in order. Matching
+	 * messages received while waiting are handed over directly, without being
+	 * stored in the receive buffer.
+	 *
+	 * @param aMsg object to store received message
+	 * @param aIdCode id to match
+	 * @param aIdMask relevant id bits ("1" = relevant)
+	 * @param aTimeoutMs time to wait for matching message
+	 * @return true when valid message is returned by function
+	 */
+	virtual bool getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs) = 0;
+
+	/**
+	 * Get file descriptor signaling received messages.
+	 * The descriptor is readable while the receive buffer is not empty, and can
+	 * be waited upon with select/poll/epoll. It remains owned by the adapter, and
+	 * must not be read from or closed by the caller.
+	 *
+	 * @return file descriptor, -1 if not supported
+	 */
+	virtual int getReceiveEventFd() = 0;
+
+	/**
+	 * Register callback for received messages.
+	 * Depending on the "rx_mode" parameter ("buffered", "callback" or "both"),
+	 * received messages are passed to the callback instead of, or in addition to,
+	 * being stored in the receive buffer. Without a callback, messages are always
+	 * buffered. Can only be called while the adapter is closed.
+	 *
+	 * @param aCallback callback (empty function to unregister)
+	 * @return true if successful
+	 */
+	virtual bool setReceiveCallback(ReceiveCallback aCallback) = 0;
 
 	/**
 	 * Get number of successfully sent messages stored in transmit acknowledge buffer.
@@ -166,7 +248,16 @@ public:
 	 * @param aTimeoutMs time to wait for received message
 	 * @return true when valid message is returned by function
 	 */
-	virtual bool getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs) = 0;
+	virtual bool getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs) = 0;
+
+	/**
+	 * Get file descriptor signaling transmit acknowledgments.
+	 * The descriptor is readable while the transmit acknowledge buffer is not
+	 * empty (see getReceiveEventFd()).
+	 *
+	 * @return file descriptor, -1 if not supported
+	 */
+	virtual int getSendAcknEventFd() = 0;
 
 	/**
 	 * Close interface.
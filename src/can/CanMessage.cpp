@@ -18,44 +18,101 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
+#include <boost/make_shared.hpp>
+
 #include "CanMessage.h"
 
 namespace pt = boost::posix_time;
 
-pt::ptime CanMessage::mCanEpoch = pt::microsec_clock::local_time();
+uint64_t CanMessage::mCanEpochNs = CanMessage::getCurrentTimeStampNs();
+
+uint64_t CanMessage::getCurrentTimeStampNs(){
+	static const pt::ptime unixEpoch(boost::gregorian::date(1970, 1, 1));
+	pt::time_duration d = pt::microsec_clock::universal_time() - unixEpoch;
+	return (uint64_t)d.total_microseconds() * 1000;
+}
 
 SharedCanMessage CanMessage::getSharedInstance(uint32_t aId, unsigned int aLen, bool aIsExt){
 	if(aId > 0x800){
 		// automatically set extended ID if ID out of 11 bit range
 		aIsExt = true;
 	}
-	SharedCanMessage msg(new CanMessage(aId, aLen,aIsExt));
-	return msg;
+	return boost::make_shared<CanMessage>(aId, aLen, aIsExt);
 }
 
 SharedCanMessage CanMessage::getSharedInstance(SharedCanMessage aMsg){
-	CanMessage *msg = new CanMessage(aMsg->getId(), aMsg->getLen(), aMsg->isExtended());
+	SharedCanMessage msg = boost::make_shared<CanMessage>(aMsg->getId(), aMsg->getLen(), aMsg->isExtended());
+	msg->setFd(aMsg->isFd(), aMsg->hasBitRateSwitch(), aMsg->hasErrorStateIndicator());
 	for(int i=0; i<aMsg->getLen(); i++){
 		msg->setData(i, aMsg->getData(i));
 	}
-	return(SharedCanMessage(msg));
+	return(msg);
+}
+
+SharedCanMessage CanMessage::getSharedInstance(const CanMessage &aMsg){
+	return boost::make_shared<CanMessage>(aMsg);
 }
 
 CanMessage::CanMessage(uint32_t aId, unsigned int aLen, bool aIsExt) :
-	mId(aId), mLen(aLen), mIsExt(aIsExt){
+	mId(aId), mLen(aLen), mFlags(aIsExt ? FlagExtended : 0), mTransactionId(0), mTimeStampNs(getCurrentTimeStampNs()){
+
+	memset(mData, DEFAULT_PADDING, MaxLen);
+}
+
+CanMessage::CanMessage(uint32_t aId, unsigned int aLen, bool aIsExt, uint64_t aTimeStampNs) :
+	mId(aId), mLen(aLen), mFlags(aIsExt ? FlagExtended : 0), mTransactionId(0), mTimeStampNs(aTimeStampNs){
+
+	memset(mData, DEFAULT_PADDING, MaxLen);
+}
+
+CanMessage::CanMessage() :
+	mId(0), mLen(0), mFlags(0), mTransactionId(0), mTimeStampNs(0){
+
+	memset(mData, DEFAULT_PADDING, MaxLen);
+}
 
-	pt::time_duration d = pt::microsec_clock::local_time() - mCanEpoch;
-	mTimeStamp = d.total_milliseconds();
+void CanMessage::setFd(bool aIsFd, bool aBrs, bool aEsi){
+	mFlags &= FlagExtended;
+	if(aIsFd){
+		mFlags |= FlagFd;
+		if(aBrs){
+			mFlags |= FlagBitRateSwitch;
+		}
+		if(aEsi){
+			mFlags |= FlagErrorStateIndicator;
+		}
+	}
+}
 
-	for(int i=0; i<8; i++){
-		mData[i] = DEFAULT_PADDING;
+unsigned int CanMessage::getValidFdLen(unsigned int aLen){
+	static const uint8_t lens[] = {8, 12, 16, 20, 24, 32, 48, 64};
+	if(aLen <= 8){
+		return aLen;
+	}
+	for(unsigned int i=0; i<sizeof(lens); i++){
+		if(aLen <= lens[i]){
+			return lens[i];
+		}
 	}
+	return MaxLen;
 }
 
-CanMessage::CanMessage(){
+bool operator==(const CanMessage &m1, const CanMessage &m2){
+	if((m1.mId != m2.mId) || (m1.mFlags != m2.mFlags) || (m1.mLen != m2.mLen)){
+		return(false);
+	}
+	for(int i=0; i<m1.mLen; i++){
+		if(m1.mData[i] != m2.mData[i]){
+			return(false);
+		}
+	}
+	return(true);
 }
 
-CanMessage::~CanMessage(){
+bool operator!=(const CanMessage &m1, const CanMessage &m2){
+	return(!(m1==m2));
 }
 
 bool operator==(SharedCanMessage &m1, SharedCanMessage &m2){
@@ -67,12 +124,19 @@ bool operator!=(SharedCanMessage &m1, SharedCanMessage &m2){
 	return(!(m1==m2));
 }
 
+std::ostream& operator<<(std::ostream& os, const CanMessage& msg){
+	os << "Msg ID: 0x" << std::hex << msg.mId << ", len: " << std::dec << (unsigned int)msg.mLen;
+	if(msg.isFd()){
+		os << " (FD)";
+	}
+	return os;
+}
+
 std::ostream& operator<<(std::ostream& os, const SharedCanMessage& msg){
 	if(msg == NULL){
 		os << "NULL Msg";
 	} else {
-		os << "Msg ID: 0x" << std::hex << msg->mId << ", len: " << std::dec << msg->mLen;
+		os << *msg;
 	}
 	return os;
 }
-
@@ -32,44 +32,104 @@
 class CanMessage;
 typedef boost::shared_ptr<CanMessage> SharedCanMessage;
 
+/**
+ * CAN message (classic or CAN FD).
+ * Compact value type that is trivially copyable, so that messages can be
+ * passed through buffers and adapters without any heap allocation.
+ * With room for 64 data bytes a message occupies 80 bytes, which are copied
+ * by buffers in batches, whereas a shared pointer costs an allocation and
+ * atomic reference counting per message.
+ * SharedCanMessage is retained as a thin compatibility layer.
+ */
 class CanMessage{
 public:
 	static const uint8_t DEFAULT_PADDING = 0xFF;
+	enum {MaxLen = 64, MaxClassicLen = 8};
 
 	static SharedCanMessage getSharedInstance(uint32_t aId, unsigned int aLen, bool aIsExt=false);
 	static SharedCanMessage getSharedInstance(SharedCanMessage aMsg);
-	virtual ~CanMessage();
+	static SharedCanMessage getSharedInstance(const CanMessage &aMsg);
+
+	CanMessage();
+	CanMessage(uint32_t aId, unsigned int aLen, bool aIsExt=false);
+	CanMessage(uint32_t aId, unsigned int aLen, bool aIsExt, uint64_t aTimeStampNs);
+
+	/**
+	 * Current time in nanoseconds since the Unix epoch (UTC), as used for message time-stamps.
+	 */
+	static uint64_t getCurrentTimeStampNs();
 
 	uint32_t getId() const {return mId; };
 	unsigned int getLen() const {return mLen; };
-	bool isExtended() const {return mIsExt; };
-	uint32_t getTimestamp() const {return mTimeStamp; };
+	bool isExtended() const {return (mFlags & FlagExtended) != 0; };
+	bool isFd() const {return (mFlags & FlagFd) != 0; };
+	bool hasBitRateSwitch() const {return (mFlags & FlagBitRateSwitch) != 0; };
+	bool hasErrorStateIndicator() const {return (mFlags & FlagErrorStateIndicator) != 0; };
+
+	/**
+	 * Marks message as CAN FD frame.
+	 * @param aIsFd true for CAN FD frame (up to 64 bytes)
+	 * @param aBrs bit rate switch (data phase at data bitrate)
+	 * @param aEsi error state indicator (transmitter is error passive)
+	 */
+	void setFd(bool aIsFd, bool aBrs=false, bool aEsi=false);
+
+	/**
+	 * Rounds length up to the next valid CAN FD payload length (0..8, 12, 16, 20, 24, 32, 48, 64).
+	 */
+	static unsigned int getValidFdLen(unsigned int aLen);
+	uint32_t getTimestamp() const {return getTimeStamp(); };
 	uint8_t getData(unsigned int aIndex) const {return mData[aIndex]; };
 	void setData(unsigned int aIndex, uint8_t aData) { mData[aIndex] = aData; };
-	uint32_t getTimeStamp() const {return mTimeStamp; };
+	const uint8_t *getDataPtr() const {return mData; };
+	uint8_t *getDataPtr() {return mData; };
+
+	/**
+	 * Time-stamp in milliseconds, relative to the start of the application.
+	 */
+	uint32_t getTimeStamp() const {
+		return (mTimeStampNs > mCanEpochNs) ? (uint32_t)((mTimeStampNs - mCanEpochNs)/1000000) : 0;
+	};
+
+	/**
+	 * Time-stamp in nanoseconds since the Unix epoch (UTC), or in the adapter's
+	 * clock domain if hardware time-stamping is used.
+	 */
+	uint64_t getTimeStampNs() const {return mTimeStampNs; };
+	void setTimeStampNs(uint64_t aTimeStampNs) { mTimeStampNs = aTimeStampNs; };
+
+	/**
+	 * Transaction id assigned by the adapter upon sendMessage() (0 if none).
+	 */
+	uint16_t getTransactionId() const {return mTransactionId; };
+	void setTransactionId(uint16_t aTransactionId) { mTransactionId = aTransactionId; };
 
 	// for display of messages
+	friend std::ostream& operator<<(std::ostream& os, const CanMessage& msg);
 	friend std::ostream& operator<<(std::ostream& os, const SharedCanMessage& msg);
 
 	// for testing and debugging
+	friend bool operator== (const CanMessage &m1, const CanMessage &m2);
+	friend bool operator!= (const CanMessage &m1, const CanMessage &m2);
 	friend bool operator== (SharedCanMessage &m1, SharedCanMessage &m2);
 	friend bool operator!= (SharedCanMessage &m1, SharedCanMessage &m2);
 
 private:
-	CanMessage();
-	CanMessage(uint32_t aId, unsigned int aLen, bool aIsExt);
-
-	// make uncopyable (we only want to use shared pointers
-	CanMessage(const CanMessage&);
-	CanMessage& operator=(const CanMessage&);
+	enum {
+		FlagExtended = 0x01,
+		FlagFd = 0x02,
+		FlagBitRateSwitch = 0x04,
+		FlagErrorStateIndicator = 0x08
+	};
 
-	static boost::posix_time::ptime mCanEpoch;
+	static uint64_t mCanEpochNs;
 
 	uint32_t mId;
-	bool mIsExt; // true if extended message
-	unsigned int mLen; // message length
-	uint8_t mData[8]; // data (with padding if necessary)
-	uint32_t mTimeStamp; // time-stamp of when message was created (received, tx ackn, etc)
+	uint8_t mLen; // message length
+	uint8_t mFlags; // extended id, FD, BRS, ESI
+	uint16_t mTransactionId; // of transmitted messages
+	uint8_t mData[MaxLen]; // data (with padding if necessary)
+	uint64_t mTimeStampNs; // time-stamp of when message was received, tx acknowledged, etc (ns)
 };
 
 #endif // CAN_MESSAGE_H_
@@ -22,9 +22,16 @@
 #define CAN_MESSAGE_BUFFER_H_
 
 #include "../utils/BlockingBufferWithTimeout.hpp"
+#include "../utils/SpscRingBuffer.hpp"
 
 #include "CanMessage.h"
 
-typedef BlockingBufferWithTimeout<SharedCanMessage> CanMessageBuffer;
+typedef BlockingBufferWithTimeout<CanMessage> CanMessageBuffer;
+
+/**
+ * Buffer for queues with a single producer thread (e.g. receive buffers
+ * filled by the adapter's io/receive thread).
+ */
+typedef SpscRingBuffer<CanMessage> CanMessageRingBuffer;
 
 #endif /* CAN_MESSAGE_BUFFER_H_ */
@@ -25,6 +25,7 @@
 #include <stdint.h>
 #endif
 
+#include <vector>
 #include <boost/shared_ptr.hpp>
 
 #include "CanMessage.h"
@@ -46,7 +47,19 @@ public:
 	 * @param aTransactionId id associated with transmission (set to nullptr if not used)
 	 * @return true if successful
 	 */
-	virtual bool sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId) = 0;
+	virtual bool sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId) = 0;
+
+	/**
+	 * Send several messages.
+	 * Queues CAN messages into transmit buffer, in order, handing them over
+	 * to the adapter as a batch. Transaction ids are assigned consecutively,
+	 * starting with the id returned for the first message.
+	 *
+	 * @param aMsgs CAN messages
+	 * @param aFirstTransactionId id associated with transmission of first message (set to nullptr if not used)
+	 * @return number of messages queued
+	 */
+	virtual int sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId) = 0;
 
 	/**
 	 * Get number of messages in receive buffer.
@@ -62,7 +75,33 @@ public:
 	 * @param aTimeoutMs time to wait for received message
 	 * @return true when valid message is returned by function
 	 */
-	virtual bool getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs) = 0;
+	virtual bool getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs) = 0;
+
+	/**
+	 * Retrieve several messages from receive buffer.
+	 * Blocks until at least one message is available, or the timeout expires,
+	 * and then returns all messages available up to the specified maximum.
+	 *
+	 * @param aMsgs vector to store received messages (resized to number of messages retrieved)
+	 * @param aMaxMsgs maximum number of messages to retrieve
+	 * @param aTimeoutMs time to wait for received message
+	 * @return number of messages retrieved
+	 */
+	virtual int getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs) = 0;
+
+	/**
+	 * Retrieve message with matching id from receive buffer.
+	 * Messages that do not match remain in the receive buffer, in order. Matching
+	 * messages received while waiting are handed over directly, without being
+	 * stored in the receive buffer.
+	 *
+	 * @param aMsg object to store received message
+	 * @param aIdCode id to match
+	 * @param aIdMask relevant id bits ("1" = relevant)
+	 * @param aTimeoutMs time to wait for matching message
+	 * @return true when valid message is returned by function
+	 */
+	virtual bool getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs) = 0;
 
 	/**
 	 * Get number of successfully sent messages stored in transmit acknowledge buffer.
@@ -84,7 +123,7 @@ public:
 	 * @param aTimeoutMs time to wait for received message
 	 * @return true when valid message is returned by function
 	 */
-	virtual bool getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs) = 0;
+	virtual bool getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs) = 0;
 
 	/**
 	 *  Getter for error code corresponding to last error that occurred.
@@ -108,6 +147,36 @@ public:
 	 *  @param aRxErrorCounter number of receive errors
 	 */
 	virtual void getErrorCounters(int *aTxErrorCounter, int *aRxErrorCounter) = 0;
+
+	/*
+	 * Shared pointer variants, retained for compatibility.
+	 * These allocate a message on the heap and should be avoided on hot paths.
+	 */
+
+	bool sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId){
+		if(!aMsg){
+			return false;
+		}
+		return sendMessage(*aMsg, aTransactionId);
+	}
+
+	bool getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs){
+		CanMessage msg;
+		if(!getReceivedMessage(msg, aTimeoutMs)){
+			return false;
+		}
+		aMsg = CanMessage::getSharedInstance(msg);
+		return true;
+	}
+
+	bool getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
+		CanMessage msg;
+		if(!getSendAcknMessage(msg, aTransactionId, aTimeoutMs)){
+			return false;
+		}
+		aMsg = CanMessage::getSharedInstance(msg);
+		return true;
+	}
 };
 
 #endif /* CAN_PORT_H_ */
@@ -0,0 +1,256 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2018 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAN_RECEIVE_DISPATCHER_H_
+#define CAN_RECEIVE_DISPATCHER_H_
+
+#include <string>
+#include <deque>
+#include <map>
+#include <boost/atomic.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "CanAdapter.h"
+#include "CanMessageBuffer.h"
+
+/**
+ * Delivers received messages to the receive buffer and/or the receive
+ * callback of an adapter, according to its "rx_mode" parameter.
+ * Configuration must not change while the adapter is open, so that the
+ * receive thread can dispatch without synchronization.
+ *
+ * Callers waiting in getMatching() are handed matching messages directly,
+ * instead of them being stored in the receive buffer. Waiters are kept in
+ * per-id lists for each distinct mask, so that looking up the waiter for a
+ * message does not depend on the number of waiters. The receive thread only
+ * takes a lock while there are waiters.
+ */
+class CanReceiveDispatcher {
+public:
+	enum Mode {
+		Buffered = 0,
+		Callback = 1,
+		Both = 2
+	};
+
+	CanReceiveDispatcher() : mMode(Buffered), mCallback(), mNumWaiters(0), mDispatching(false),
+			mWaitMutex(), mWaiters(), mNextWaiterSeq(0) {};
+
+	bool setMode(const std::string &aMode){
+		if(aMode == "buffered"){
+			mMode = Buffered;
+		} else if(aMode == "callback"){
+			mMode = Callback;
+		} else if(aMode == "both"){
+			mMode = Both;
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	std::string getMode() const {
+		switch(mMode){
+		case Callback:
+			return "callback";
+		case Both:
+			return "both";
+		default:
+			return "buffered";
+		}
+	}
+
+	void setCallback(CanAdapter::ReceiveCallback aCallback){
+		mCallback = aCallback;
+	}
+
+	/**
+	 * Dispatches batch of received messages.
+	 * The callback is passed all messages, including those handed to waiters.
+	 * @return number of messages delivered (i.e. not dropped due to a full buffer)
+	 */
+	std::size_t dispatch(CanMessageRingBuffer &aBuf, const CanMessage *aMsgs, std::size_t aCount){
+		if(mCallback.empty() || (mMode != Callback)){
+			std::size_t n = deliver(aBuf, aMsgs, aCount, true);
+			if(mCallback.empty() || (mMode == Buffered)){
+				return n;
+			}
+		} else {
+			deliver(aBuf, aMsgs, aCount, false);
+		}
+		mCallback(aMsgs, aCount);
+		return aCount;
+	}
+
+	/**
+	 * Retrieves first message with matching id, either from the receive
+	 * buffer or, while waiting, directly from the receive thread. Messages
+	 * that do not match remain in the receive buffer.
+	 * Concurrent waiters for the same message are served in order.
+	 *
+	 * @param aBuf receive buffer
+	 * @param aMsg object to store received message
+	 * @param aIdCode id to match
+	 * @param aIdMask relevant id bits ("1" = relevant)
+	 * @param aTimeoutMs time to wait for matching message
+	 * @return true when valid message is returned
+	 */
+	bool getMatching(CanMessageRingBuffer &aBuf, CanMessage &aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+		mNumWaiters.fetch_add(1, boost::memory_order_seq_cst);
+		// a receive thread which has not seen us yet must finish pushing into the buffer
+		while(mDispatching.load(boost::memory_order_seq_cst)){
+			boost::this_thread::yield();
+		}
+
+		boost::mutex::scoped_lock lock(mWaitMutex);
+		bool matched = aBuf.popFirst(aMsg, IdMatcher(aIdCode, aIdMask));
+		if(!matched && (aTimeoutMs > 0)){
+			Waiter waiter(aIdCode, aIdMask, mNextWaiterSeq++);
+			mWaiters[aIdMask][waiter.mCode].push_back(&waiter);
+			boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(aTimeoutMs);
+			while(!waiter.mMatched){
+				if(!waiter.mNotifier.timed_wait(lock, deadline)){
+					break;
+				}
+			}
+			if(waiter.mMatched){
+				aMsg = waiter.mMsg;
+				matched = true;
+			} else {
+				removeWaiter(&waiter);
+			}
+		}
+		lock.unlock();
+		mNumWaiters.fetch_sub(1, boost::memory_order_release);
+		return matched;
+	}
+
+private:
+	struct Waiter {
+		Waiter(uint32_t aIdCode, uint32_t aIdMask, uint64_t aSeq) :
+			mCode(aIdCode & aIdMask), mMask(aIdMask), mSeq(aSeq), mMsg(), mMatched(false), mNotifier() {};
+
+		uint32_t mCode;
+		uint32_t mMask;
+		uint64_t mSeq;
+		CanMessage mMsg;
+		bool mMatched;
+		boost::condition_variable mNotifier;
+	};
+
+	// waiters by masked id, oldest first
+	typedef std::deque<Waiter*> WaiterQueue;
+	typedef boost::unordered_map<uint32_t, WaiterQueue> WaiterMap;
+	// one entry per distinct mask in use
+	typedef std::map<uint32_t, WaiterMap> MaskMap;
+
+	struct IdMatcher {
+		IdMatcher(uint32_t aIdCode, uint32_t aIdMask) : mCode(aIdCode & aIdMask), mMask(aIdMask) {};
+
+		bool operator()(const CanMessage &aMsg) const {
+			return (aMsg.getId() & mMask) == mCode;
+		}
+
+		uint32_t mCode;
+		uint32_t mMask;
+	};
+
+	// hands messages to waiters, and pushes the others into the buffer (in order)
+	std::size_t deliver(CanMessageRingBuffer &aBuf, const CanMessage *aMsgs, std::size_t aCount, bool aBuffered){
+		mDispatching.store(true, boost::memory_order_seq_cst);
+		if(mNumWaiters.load(boost::memory_order_seq_cst) == 0){
+			std::size_t n = aBuffered ? aBuf.pushMany(aMsgs, aCount, 0) : 0;
+			mDispatching.store(false, boost::memory_order_release);
+			return n;
+		}
+		mDispatching.store(false, boost::memory_order_release);
+
+		// waiters look into the buffer before registering, hence push with the lock held
+		boost::mutex::scoped_lock lock(mWaitMutex);
+		std::size_t n = 0;
+		std::size_t first = 0;
+		for(std::size_t i=0; i<aCount; i++){
+			if(handOver(aMsgs[i])){
+				if(aBuffered && (i > first)){
+					n += aBuf.pushMany(&aMsgs[first], i - first, 0);
+				}
+				first = i + 1;
+				n++;
+			}
+		}
+		if(aBuffered && (aCount > first)){
+			n += aBuf.pushMany(&aMsgs[first], aCount - first, 0);
+		}
+		return n;
+	}
+
+	// only to be called with wait mutex held
+	bool handOver(const CanMessage &aMsg){
+		WaiterQueue *oldest = NULL;
+		for(MaskMap::iterator it = mWaiters.begin(); it != mWaiters.end(); ++it){
+			WaiterMap::iterator w = it->second.find(aMsg.getId() & it->first);
+			if((w != it->second.end()) && ((oldest == NULL) || (w->second.front()->mSeq < oldest->front()->mSeq))){
+				oldest = &w->second;
+			}
+		}
+		if(oldest == NULL){
+			return false;
+		}
+		Waiter *waiter = oldest->front();
+		removeWaiter(waiter);
+		waiter->mMsg = aMsg;
+		waiter->mMatched = true;
+		waiter->mNotifier.notify_one();
+		return true;
+	}
+
+	// only to be called with wait mutex held
+	void removeWaiter(Waiter *aWaiter){
+		MaskMap::iterator m = mWaiters.find(aWaiter->mMask);
+		WaiterMap::iterator w = m->second.find(aWaiter->mCode);
+		WaiterQueue &queue = w->second;
+		for(WaiterQueue::iterator it = queue.begin(); it != queue.end(); ++it){
+			if(*it == aWaiter){
+				queue.erase(it);
+				break;
+			}
+		}
+		if(queue.empty()){
+			m->second.erase(w);
+			if(m->second.empty()){
+				mWaiters.erase(m);
+			}
+		}
+	}
+
+	Mode mMode;
+	CanAdapter::ReceiveCallback mCallback;
+
+	// number of callers in getMatching(), and whether receive thread is pushing without lock
+	boost::atomic<uint32_t> mNumWaiters;
+	boost::atomic<bool> mDispatching;
+
+	boost::mutex mWaitMutex;
+	MaskMap mWaiters;
+	uint64_t mNextWaiterSeq;
+};
+
+#endif /* CAN_RECEIVE_DISPATCHER_H_ */
@@ -33,6 +33,9 @@ public:
 	/* Interface implementation */
 	bool setParameter(std::string aKey, std::string aValue){ return false; };
 
+	/* Interface implementation */
+	bool getParameter(std::string aKey, std::string &aValue){ return false; };
+
 	/* Interface implementation */
 	bool setBaudRate(uint32_t aBaudrate){ return false; };
 
@@ -52,19 +55,40 @@ public:
 	bool goBusOff(){ return false; };
 
 	/* Interface implementation */
-	bool sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId){ return false; };
+	bool sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId){ return false; };
+
+	/* Interface implementation */
+	int sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId){ return 0; };
 
 	/* Interface implementation */
 	int numReceivedMessagesAvailable(){ return 0; };
 
 	/* Interface implementation */
-	bool getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs){ return false; };
+	bool getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs){ return false; };
+
+	/* Interface implementation */
+	int getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs){
+		aMsgs.clear();
+		return 0;
+	};
+
+	/* Interface implementation */
+	bool getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){ return false; };
+
+	/* Interface implementation */
+	int getReceiveEventFd(){ return -1; };
+
+	/* Interface implementation */
+	bool setReceiveCallback(ReceiveCallback aCallback){ return false; };
 
 	/* Interface implementation */
 	int numSendAcknMessagesAvailable(){ return 0; };
 
 	/* Interface implementation */
-	bool getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){ return false; };
+	bool getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){ return false; };
+
+	/* Interface implementation */
+	int getSendAcknEventFd(){ return -1; };
 
 	/* Interface implementation */
 	void close(){ return; };
@@ -0,0 +1,147 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2018 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utility>
+
+#include <boost/asio.hpp>
+
+#pragma once
+
+/*
+ * C++20 coroutine interface, e.g.
+ *
+ *   boost::asio::awaitable<void> request(CanAwaitableIoObject<> &can){
+ *     co_await can.send(req);
+ *     SharedCanMessage rsp = co_await can.receiveFor(0x7E8, std::chrono::milliseconds(50));
+ *   }
+ *
+ * Coroutines must run on the io_service of the object. Errors are thrown as
+ * boost::system::system_error when awaited with use_awaitable.
+ */
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+
+#include <chrono>
+#include <memory>
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/system/system_error.hpp>
+
+#include "CanAsyncIoObject.hpp"
+#include "CanAsyncService.hpp"
+
+template <typename Service = CanAsyncService<> >
+class CanAwaitableIoObject
+	: public CanAsyncIoObject<Service>
+{
+public:
+	explicit CanAwaitableIoObject(boost::asio::io_service &io_service)
+	: CanAsyncIoObject<Service>(io_service)
+	{
+	}
+
+	/**
+	 * Awaits next received message.
+	 */
+	template <typename CompletionToken = boost::asio::use_awaitable_t<> >
+	auto receive(CompletionToken &&token = CompletionToken())
+	{
+		return boost::asio::async_initiate<CompletionToken, void (boost::system::error_code, SharedCanMessage)>(
+				[this](auto handler){
+					this->asyncGetReceivedMessage(SharedHandler<decltype(handler)>(std::move(handler)));
+				}, token);
+	}
+
+	/**
+	 * Awaits next received message, fails with timed_out after aTimeout.
+	 */
+	template <typename Rep, typename Period, typename CompletionToken = boost::asio::use_awaitable_t<> >
+	auto receive(std::chrono::duration<Rep, Period> aTimeout, CompletionToken &&token = CompletionToken())
+	{
+		boost::posix_time::time_duration timeout = toTimeDuration(aTimeout);
+		return boost::asio::async_initiate<CompletionToken, void (boost::system::error_code, SharedCanMessage)>(
+				[this, timeout](auto handler){
+					this->asyncGetReceivedMessage(timeout, SharedHandler<decltype(handler)>(std::move(handler)));
+				}, token);
+	}
+
+	/**
+	 * Sends message, and awaits its acknowledgment.
+	 */
+	template <typename CompletionToken = boost::asio::use_awaitable_t<> >
+	auto send(const SharedCanMessage &aMsg, CompletionToken &&token = CompletionToken())
+	{
+		return boost::asio::async_initiate<CompletionToken, void (boost::system::error_code, SharedCanMessage)>(
+				[this, aMsg](auto handler){
+					this->asyncSendMessage(aMsg, SharedHandler<decltype(handler)>(std::move(handler)));
+				}, token);
+	}
+
+	/**
+	 * Awaits message with identifier aId, fails with timed_out after aTimeout.
+	 * Messages with other identifiers remain available to other receivers.
+	 */
+	template <typename Rep, typename Period, typename CompletionToken = boost::asio::use_awaitable_t<> >
+	auto receiveFor(uint32_t aId, std::chrono::duration<Rep, Period> aTimeout, CompletionToken &&token = CompletionToken())
+	{
+		boost::posix_time::time_duration timeout = toTimeDuration(aTimeout);
+		return boost::asio::async_initiate<CompletionToken, void (boost::system::error_code, SharedCanMessage)>(
+				[this, aId, timeout](auto handler){
+					this->asyncGetReceivedMessageFor(aId, timeout, SharedHandler<decltype(handler)>(std::move(handler)));
+				}, token);
+	}
+
+private:
+	template <typename Rep, typename Period>
+	static boost::posix_time::time_duration toTimeDuration(std::chrono::duration<Rep, Period> aDuration)
+	{
+		return boost::posix_time::microseconds(
+				std::chrono::duration_cast<std::chrono::microseconds>(aDuration).count());
+	}
+
+	/*
+	 * The service requires copyable handlers, whereas coroutine completion
+	 * handlers can only be moved, so they are shared instead. The handler is
+	 * resumed on its own executor.
+	 */
+	template <typename Handler>
+	class SharedHandler
+	{
+	public:
+		explicit SharedHandler(Handler &&handler)
+		: handler_(std::make_shared<Handler>(std::move(handler)))
+		{
+		}
+
+		void operator() (const boost::system::error_code &ec, SharedCanMessage aMsg)
+		{
+			std::shared_ptr<Handler> handler = handler_;
+			boost::asio::dispatch(boost::asio::get_associated_executor(*handler),
+					[handler, ec, aMsg]() mutable { (*handler)(ec, aMsg); });
+		}
+
+	private:
+		std::shared_ptr<Handler> handler_;
+	};
+};
+
+#endif // BOOST_ASIO_HAS_CO_AWAIT
@@ -20,6 +20,7 @@
 
 #include <boost/asio.hpp>
 #include <cstddef>
+#include <vector>
 
 #include "../can/CanAdapter.h"
 
@@ -61,6 +62,52 @@ public:
 		this->get_service().asyncGetReceivedMessage(this->get_implementation(), handler);
 	}
 
+	template <typename Handler>
+	void asyncGetReceivedMessage(boost::posix_time::time_duration aTimeout, Handler handler)
+	{
+		this->get_service().asyncGetReceivedMessage(this->get_implementation(), aTimeout, handler);
+	}
+
+	template <typename Handler>
+	void asyncGetReceivedMessageFor(uint32_t aId, Handler handler)
+	{
+		this->get_service().asyncGetReceivedMessageFor(this->get_implementation(), aId, handler);
+	}
+
+	template <typename Handler>
+	void asyncGetReceivedMessageFor(uint32_t aId, boost::posix_time::time_duration aTimeout, Handler handler)
+	{
+		this->get_service().asyncGetReceivedMessageFor(this->get_implementation(), aId, aTimeout, handler);
+	}
+
+	template <typename Handler>
+	void asyncGetReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, Handler handler)
+	{
+		this->get_service().asyncGetReceivedMessages(this->get_implementation(), aMsgs, aMaxMsgs, handler);
+	}
+
+	/**
+	 * Sets the maximum number of asynchronous sends awaiting acknowledgment.
+	 */
+	void setMaxPendingSends(std::size_t aMaxPendingSends)
+	{
+		this->get_service().setMaxPendingSends(this->get_implementation(), aMaxPendingSends);
+	}
+
+	/**
+	 * Sets the time an asynchronous send waits for its acknowledgment.
+	 */
+	void setSendTimeout(boost::posix_time::time_duration aTimeout)
+	{
+		this->get_service().setSendTimeout(this->get_implementation(), aTimeout);
+	}
+
+	template <typename Handler>
+	void asyncSendMessage(const SharedCanMessage &aMsg, Handler handler)
+	{
+		this->get_service().asyncSendMessage(this->get_implementation(), aMsg, handler);
+	}
+
 	template <typename Handler>
 	void asyncGetSendAcknMessage(uint16_t transactionId, Handler handler)
 	{
@@ -18,18 +18,55 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <deque>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include <boost/bind.hpp>
+#include <boost/bind/protect.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/version.hpp>
 #include <boost/system/error_code.hpp>
 
+#if defined(BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
+#include <unistd.h>
+#endif
+
 #include "CanAsyncWrapper.h"
 
 #pragma once
 
+/*
+ * Asynchronous operations are driven by the readiness of the adapter's receive
+ * and transmit acknowledge buffers: if the adapter provides event descriptors,
+ * they are waited upon by the reactor of the owning io_service, otherwise the
+ * buffers are polled by means of a timer. Pending operations of an
+ * implementation are queued, and completed in order as messages become
+ * available, so no thread is blocked on behalf of an idle adapter.
+ *
+ * While operations wait for messages with given identifiers, all messages are
+ * retrieved from the adapter as it becomes readable, and routed to them by
+ * identifier. Messages not claimed are set aside for the other receive
+ * operations, in order of reception.
+ *
+ * Messages sent asynchronously are handed to the adapter by a pool of private
+ * threads, with a bounded number of transmissions awaiting acknowledgment per
+ * implementation. Transmissions of an implementation are serialized by a
+ * strand, so an adapter blocking while sending occupies one thread at most.
+ * Acknowledgments are matched by transaction id, in order of transmission
+ * for adapters not supporting transaction ids. A send not acknowledged in
+ * time (e.g. as the adapter failed to transmit it) completes with timed_out.
+ * While asynchronous sends or acknowledgment requests are pending, all
+ * transmit acknowledgments of the adapter are consumed by the service.
+ */
 template <typename CanAsyncImplementation = CanAsyncWrapper>
 class CanAsyncService
 		: public boost::asio::io_service::service
@@ -37,175 +74,994 @@ class CanAsyncService
 public:
 	static boost::asio::io_service::id id;
 
+	// polling interval for adapters without event descriptors
+	enum { PollIntervalMs = 1 };
+
+	// bound on messages set aside while routing by identifier, the oldest are discarded
+	enum { MaxReceiveBacklog = 4096 };
+
+	// messages retrieved from the port at once while routing by identifier
+	enum { RouteBatchSize = 64 };
+
+	// default bound on outstanding asynchronous sends
+	enum { DefaultMaxPendingSends = 16 };
+
+	// default time to wait for the acknowledgment of an asynchronous send
+	enum { DefaultSendTimeoutMs = 5000 };
+
+	// size of the pool of transmit threads
+	enum { NumTransmitThreads = 4 };
+
 	explicit CanAsyncService(boost::asio::io_service &io_service)
 	: boost::asio::io_service::service(io_service),
-	  async_work_1_(new boost::asio::io_service::work(async_io_service_1_)),
-	  async_thread_1_(boost::bind(&boost::asio::io_service::run, &async_io_service_1_)),
-	  async_work_2_(new boost::asio::io_service::work(async_io_service_2_)),
-	  async_thread_2_(boost::bind(&boost::asio::io_service::run, &async_io_service_2_))
+	  async_work_(new boost::asio::io_service::work(async_io_service_))
 	{
+		for(int i=0; i<NumTransmitThreads; i++){
+			async_threads_.create_thread(boost::bind(&boost::asio::io_service::run, &async_io_service_));
+		}
 	}
 
-	typedef boost::shared_ptr<CanAsyncImplementation> implementation_type;
+	/*
+	 * Messages available to receive operations: those set aside while routing
+	 * by identifier first, then those in the port's buffer, unless messages
+	 * are being routed.
+	 */
+	class ReceiveSource
+	{
+	public:
+		ReceiveSource(CanAsyncImplementation &port, std::deque<CanMessage> &backlog, bool routing)
+		: port_(port),
+		  backlog_(backlog),
+		  routing_(routing)
+		{
+		}
+
+		bool getReceivedMessage(SharedCanMessage &aMsg)
+		{
+			if(!backlog_.empty()){
+				aMsg = CanMessage::getSharedInstance(backlog_.front());
+				backlog_.pop_front();
+				return true;
+			}
+			return !routing_ && port_.getReceivedMessage(aMsg, 0);
+		}
+
+		std::size_t getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs)
+		{
+			if(!backlog_.empty()){
+				std::size_t count = std::min(aMaxMsgs, backlog_.size());
+				aMsgs.assign(backlog_.begin(), backlog_.begin() + count);
+				backlog_.erase(backlog_.begin(), backlog_.begin() + count);
+				return count;
+			}
+			if(routing_){
+				return 0;
+			}
+			int count = port_.getReceivedMessages(aMsgs, aMaxMsgs, 0);
+			return (count > 0) ? (std::size_t)count : 0;
+		}
+
+	private:
+		CanAsyncImplementation &port_;
+		std::deque<CanMessage> &backlog_;
+		bool routing_;
+	};
+
+	/*
+	 * Queued receive operation, attempts to complete by retrieving messages from
+	 * the source (without blocking), or completes with the error passed, if any.
+	 * Returns true if the operation has completed.
+	 */
+	typedef boost::function<bool (ReceiveSource &aSource, boost::asio::io_service &aIoService,
+			const boost::system::error_code &aError)> ReceiveOperation;
+
+	typedef boost::function<void (const boost::system::error_code &, SharedCanMessage)> ReceiveHandler;
+
+	// receive operation waiting for a message with a given identifier
+	struct IdReceiver
+	{
+		IdReceiver(boost::asio::io_service &io_service, ReceiveHandler handler)
+		: handler_(handler),
+		  timer_(io_service)
+		{
+		}
+
+		ReceiveHandler handler_;
+		boost::asio::deadline_timer timer_;
+	};
+
+	typedef boost::shared_ptr<IdReceiver> SharedIdReceiver;
+	typedef boost::unordered_map<uint32_t, std::deque<SharedIdReceiver> > IdReceivers;
+
+	typedef boost::function<void (const boost::system::error_code &, SharedCanMessage)> SendHandler;
+
+	// send awaiting acknowledgment, completes with timed_out when its timer expires
+	struct PendingSend
+	{
+		PendingSend(SendHandler handler, boost::shared_ptr<boost::asio::deadline_timer> timer)
+		: handler_(handler),
+		  timer_(timer)
+		{
+		}
+
+		SendHandler handler_;
+		boost::shared_ptr<boost::asio::deadline_timer> timer_;
+	};
+
+	typedef boost::unordered_map<uint16_t, std::deque<PendingSend> > PendingSends;
+
+	/*
+	 * Waits for a buffer of the port to become non-empty, on its event descriptor
+	 * if available, or by polling otherwise. At most one wait is outstanding.
+	 * Must be used with the corresponding mutex of the implementation held.
+	 */
+	class ReadinessWaiter
+		: private boost::noncopyable
+	{
+	public:
+		explicit ReadinessWaiter(boost::asio::io_service &io_service)
+		:
+#if defined(BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
+		  descriptor_(io_service),
+#endif
+		  timer_(io_service),
+		  waiting_(false),
+		  generation_(0)
+		{
+		}
+
+		void assign(int fd)
+		{
+			close();
+#if defined(BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
+			if(fd < 0){
+				return;
+			}
+			// wait on a duplicate, as the descriptor remains owned by the adapter
+			int dupFd = ::dup(fd);
+			if(dupFd >= 0){
+				boost::system::error_code ec;
+				descriptor_.assign(dupFd, ec);
+				if(ec){
+					::close(dupFd);
+				}
+			}
+#endif
+		}
+
+		void close()
+		{
+			boost::system::error_code ignored;
+#if defined(BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
+			descriptor_.close(ignored);
+#endif
+			cancel();
+		}
+
+		void cancel()
+		{
+			boost::system::error_code ignored;
+#if defined(BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
+			descriptor_.cancel(ignored);
+#endif
+			timer_.cancel(ignored);
+			waiting_ = false;
+			generation_++;
+		}
+
+		// handler is invoked with the generation of the wait and the error code
+		template <typename Handler>
+		void asyncWait(Handler handler)
+		{
+			if(waiting_){
+				return;
+			}
+			waiting_ = true;
+#if defined(BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
+			if(descriptor_.is_open()){
+#if BOOST_VERSION >= 106600
+				descriptor_.async_wait(boost::asio::posix::descriptor_base::wait_read,
+						boost::bind(boost::protect(handler), generation_, _1));
+#else
+				descriptor_.async_read_some(boost::asio::null_buffers(),
+						boost::bind(boost::protect(handler), generation_, _1));
+#endif
+				return;
+			}
+#endif
+			timer_.expires_from_now(boost::posix_time::milliseconds((long)PollIntervalMs));
+			timer_.async_wait(boost::bind(boost::protect(handler), generation_, _1));
+		}
+
+		// to be called by handler, returns false if the wait has been cancelled since
+		bool complete(unsigned int aGeneration, const boost::system::error_code &ec)
+		{
+			if(aGeneration != generation_){
+				return false;
+			}
+			waiting_ = false;
+#if defined(BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
+			if(ec && (ec != boost::asio::error::operation_aborted)){
+				// descriptor no longer usable, fall back to polling
+				boost::system::error_code ignored;
+				descriptor_.close(ignored);
+			}
+#endif
+			return true;
+		}
+
+	private:
+#if defined(BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
+		boost::asio::posix::stream_descriptor descriptor_;
+#endif
+		boost::asio::deadline_timer timer_;
+		bool waiting_;
+		unsigned int generation_;
+	};
+
+	class implementation
+		: private boost::noncopyable
+	{
+	public:
+		implementation(boost::asio::io_service &io_service, boost::asio::io_service &async_io_service)
+		: io_service_(io_service),
+		  port_(new CanAsyncImplementation()),
+		  rx_waiter_(io_service),
+		  tx_strand_(async_io_service),
+		  tx_max_pending_(DefaultMaxPendingSends),
+		  tx_timeout_(boost::posix_time::milliseconds((long)DefaultSendTimeoutMs)),
+		  tx_num_submitted_(0),
+		  tx_num_pending_(0),
+		  tx_epoch_(0),
+		  tx_waiter_(io_service)
+		{
+		}
+
+		boost::asio::io_service &io_service_;
+		boost::scoped_ptr<CanAsyncImplementation> port_;
+
+		// lock order: port_mutex_, rx_mutex_, tx_mutex_
+		boost::mutex port_mutex_;
+
+		boost::mutex rx_mutex_;
+		std::deque<ReceiveOperation> rx_operations_;
+		IdReceivers rx_id_receivers_; // by identifier, in order of request
+		std::deque<CanMessage> rx_backlog_; // not claimed while routing by identifier
+		std::vector<CanMessage> rx_batch_;
+		ReadinessWaiter rx_waiter_;
+
+		boost::mutex tx_mutex_;
+		boost::asio::io_service::strand tx_strand_; // serializes transmissions
+		std::size_t tx_max_pending_;
+		boost::posix_time::time_duration tx_timeout_;
+		std::size_t tx_num_submitted_; // handed to transmit thread, transaction id not yet known
+		std::size_t tx_num_pending_;
+		unsigned int tx_epoch_;
+		std::deque<std::pair<SharedCanMessage, SendHandler> > tx_queue_; // waiting for free slot
+		PendingSends tx_pending_; // waiting for acknowledgment, by transaction id in order of transmission
+		std::deque<SharedCanMessage> tx_unclaimed_; // acknowledged while submitted
+		std::deque<std::pair<uint16_t, SendHandler> > tx_ackn_requests_;
+		ReadinessWaiter tx_waiter_;
+	};
+
+	typedef boost::shared_ptr<implementation> implementation_type;
 
 	void construct(implementation_type &impl){
-		impl.reset(new CanAsyncImplementation());
+		impl.reset(new implementation(owner(), async_io_service_));
 	}
 
 	void destroy(implementation_type &impl){
-		//impl->destroy();
-		//impl->close();
+		{
+			boost::mutex::scoped_lock portLock(impl->port_mutex_);
+			boost::mutex::scoped_lock rxLock(impl->rx_mutex_);
+			boost::mutex::scoped_lock txLock(impl->tx_mutex_);
+			abortReceive(impl);
+			abortSend(impl);
+			impl->port_->close();
+		}
 		impl.reset();
 	}
 
 	bool open(implementation_type &impl, SharedCanAdapter aCanAdapter){
-		return impl->open(aCanAdapter);
+		boost::mutex::scoped_lock portLock(impl->port_mutex_);
+		boost::mutex::scoped_lock rxLock(impl->rx_mutex_);
+		boost::mutex::scoped_lock txLock(impl->tx_mutex_);
+		abortReceive(impl);
+		abortSend(impl);
+		if(!impl->port_->open(aCanAdapter)){
+			return false;
+		}
+		impl->rx_waiter_.assign(impl->port_->getReceiveEventFd());
+		impl->tx_waiter_.assign(impl->port_->getSendAcknEventFd());
+		return true;
 	}
 
 	void close(implementation_type &impl){
-		impl->close();
+		boost::mutex::scoped_lock portLock(impl->port_mutex_);
+		boost::mutex::scoped_lock rxLock(impl->rx_mutex_);
+		boost::mutex::scoped_lock txLock(impl->tx_mutex_);
+		impl->port_->close();
+		abortReceive(impl);
+		abortSend(impl);
 	}
 
 	bool sendMessage(implementation_type &impl, const SharedCanMessage &aMsg, uint16_t *transactionId){
-		return impl->sendMessage(aMsg, transactionId);
+		return impl->port_->sendMessage(aMsg, transactionId);
 	}
 
 	bool getReceivedMessage(implementation_type &impl, SharedCanMessage &aMsg, uint32_t aTimeoutMs){
-		return impl->getReceivedMessage(aMsg, aTimeoutMs);
+		{
+			boost::mutex::scoped_lock lock(impl->rx_mutex_);
+			if(!impl->rx_backlog_.empty()){
+				aMsg = CanMessage::getSharedInstance(impl->rx_backlog_.front());
+				impl->rx_backlog_.pop_front();
+				return true;
+			}
+		}
+		return impl->port_->getReceivedMessage(aMsg, aTimeoutMs);
 	}
 
 	bool getSendAcknMessage(implementation_type &impl, SharedCanMessage &aMsg, uint16_t transactionId, uint32_t aTimeoutMs){
-		return impl->getSendAcknMessage(aMsg, transactionId, aTimeoutMs);
+		return impl->port_->getSendAcknMessage(aMsg, transactionId, aTimeoutMs);
 	}
 
 	template <typename Handler>
 	class GetReceivedMessageOperation
 	{
 	public:
-		GetReceivedMessageOperation(implementation_type &impl,
-				boost::asio::io_service &io_service,
-				Handler handler)
-		: impl_(impl),
-		  io_service_(io_service),
-		  work_(io_service),
-		  handler_(handler)
+		explicit GetReceivedMessageOperation(Handler handler)
+		: handler_(handler)
 		{
 		}
 
-		void operator() () const
+		bool operator() (ReceiveSource &aSource, boost::asio::io_service &aIoService,
+				const boost::system::error_code &aError)
 		{
-			bool keepTrying = true;
-			do {
-				implementation_type impl = impl_.lock();
-				if(impl && impl->isOpen())
-				{
-					boost::system::error_code ec;
-					SharedCanMessage ndu;
-					if(impl->getReceivedMessage(ndu, 100)){
-						this->io_service_.post(boost::asio::detail::bind_handler(
-								handler_, ec, ndu));
-						keepTrying = false;
-					}
-				}
-				else
-				{
-					SharedCanMessage ndu;
-					this->io_service_.post(boost::asio::detail::bind_handler(
-							handler_, boost::asio::error::operation_aborted, ndu));
-					keepTrying = false;
-				}
-			} while (keepTrying);
+			SharedCanMessage ndu;
+			if(aError)
+			{
+				aIoService.post(boost::asio::detail::bind_handler(
+						handler_, aError, ndu));
+				return true;
+			}
+			if(!aSource.getReceivedMessage(ndu))
+			{
+				return false;
+			}
+			aIoService.post(boost::asio::detail::bind_handler(
+					handler_, boost::system::error_code(), ndu));
+			return true;
 		}
 
 	private:
-		boost::weak_ptr<CanAsyncImplementation> impl_;
-		boost::asio::io_service &io_service_;
-		boost::asio::io_service::work work_;
 		Handler handler_;
 	};
 
 	template <typename Handler>
 	void asyncGetReceivedMessage(implementation_type &impl, Handler handler)
 	{
-		this->async_io_service_1_.post(GetReceivedMessageOperation<Handler>(impl,
-				this->get_io_service(), handler));
+		startReceive(impl, GetReceivedMessageOperation<Handler>(handler));
 	}
 
+	/*
+	 * Receive operation with deadline, which completes with timed_out when the
+	 * deadline expires first.
+	 */
+	class TimedReceiveOperation
+	{
+	public:
+		TimedReceiveOperation(boost::asio::io_service &io_service, ReceiveOperation operation)
+		: state_(new State(io_service, operation))
+		{
+		}
+
+		bool operator() (ReceiveSource &aSource, boost::asio::io_service &aIoService,
+				const boost::system::error_code &aError)
+		{
+			if(state_->done_)
+			{
+				return true;
+			}
+			if(!state_->operation_(aSource, aIoService, aError))
+			{
+				return false;
+			}
+			state_->done_ = true;
+			boost::system::error_code ignored;
+			state_->timer_.cancel(ignored);
+			return true;
+		}
+
+		boost::asio::deadline_timer &timer()
+		{
+			return state_->timer_;
+		}
+
+		bool operator== (const TimedReceiveOperation &aOther) const
+		{
+			return state_ == aOther.state_;
+		}
+
+	private:
+		struct State
+		{
+			State(boost::asio::io_service &io_service, ReceiveOperation operation)
+			: operation_(operation), timer_(io_service), done_(false)
+			{
+			}
+
+			ReceiveOperation operation_;
+			boost::asio::deadline_timer timer_;
+			bool done_;
+		};
+
+		boost::shared_ptr<State> state_;
+	};
+
+	/**
+	 * Completes with the next message received, or with timed_out if none
+	 * is received within aTimeout.
+	 */
+	template <typename Handler>
+	void asyncGetReceivedMessage(implementation_type &impl, boost::posix_time::time_duration aTimeout,
+			Handler handler)
+	{
+		TimedReceiveOperation operation(owner(), GetReceivedMessageOperation<Handler>(handler));
+		operation.timer().expires_from_now(aTimeout);
+		operation.timer().async_wait(boost::bind(&CanAsyncService::handleReceiveTimeout, this,
+				boost::weak_ptr<implementation>(impl), operation, _1));
+		startReceive(impl, operation);
+	}
+
+	/**
+	 * Completes with the next message received with identifier aId. Messages
+	 * with other identifiers remain available to other receive operations.
+	 */
 	template <typename Handler>
-	class GetSendAcknMessageOperation
+	void asyncGetReceivedMessageFor(implementation_type &impl, uint32_t aId, Handler handler)
+	{
+		startIdReceive(impl, aId, SharedIdReceiver(new IdReceiver(owner(), ReceiveHandler(handler))));
+	}
+
+	/**
+	 * Completes with the next message received with identifier aId, or with
+	 * timed_out if none is received within aTimeout.
+	 */
+	template <typename Handler>
+	void asyncGetReceivedMessageFor(implementation_type &impl, uint32_t aId,
+			boost::posix_time::time_duration aTimeout, Handler handler)
+	{
+		SharedIdReceiver receiver(new IdReceiver(owner(), ReceiveHandler(handler)));
+		receiver->timer_.expires_from_now(aTimeout);
+		receiver->timer_.async_wait(boost::bind(&CanAsyncService::handleIdReceiveTimeout, this,
+				boost::weak_ptr<implementation>(impl), aId, receiver, _1));
+		startIdReceive(impl, aId, receiver);
+	}
+
+	template <typename Handler>
+	class GetReceivedMessagesOperation
 	{
 	public:
-		GetSendAcknMessageOperation(implementation_type &impl,
-				boost::asio::io_service &io_service,
-				uint16_t transactionId,
+		GetReceivedMessagesOperation(std::vector<CanMessage> &msgs,
+				std::size_t maxMsgs,
 				Handler handler)
-		: impl_(impl),
-		  io_service_(io_service),
-		  work_(io_service),
-		  transactionId_(transactionId),
+		: msgs_(msgs),
+		  maxMsgs_(maxMsgs),
 		  handler_(handler)
 		{
 		}
 
-		void operator() () const
+		bool operator() (ReceiveSource &aSource, boost::asio::io_service &aIoService,
+				const boost::system::error_code &aError)
 		{
-			bool keepTrying = true;
-			do {
-				implementation_type impl = impl_.lock();
-				if(impl && impl->isOpen())
-				{
-					boost::system::error_code ec;
-					SharedCanMessage ndu;
-					if(impl->getSendAcknMessage(ndu, transactionId_, 100)){
-						this->io_service_.post(boost::asio::detail::bind_handler(
-								handler_, ec, ndu));
-						keepTrying = false;
-					}
-				}
-				else
-				{
-					SharedCanMessage ndu;
-					this->io_service_.post(boost::asio::detail::bind_handler(
-							handler_, boost::asio::error::operation_aborted, ndu));
-					keepTrying = false;
-				}
-			} while (keepTrying);
+			if(aError)
+			{
+				msgs_.clear();
+				aIoService.post(boost::asio::detail::bind_handler(
+						handler_, aError, (std::size_t)0));
+				return true;
+			}
+			std::size_t count = aSource.getReceivedMessages(msgs_, maxMsgs_);
+			if(count == 0)
+			{
+				return false;
+			}
+			aIoService.post(boost::asio::detail::bind_handler(
+					handler_, boost::system::error_code(), count));
+			return true;
 		}
 
 	private:
-		boost::weak_ptr<CanAsyncImplementation> impl_;
-		boost::asio::io_service &io_service_;
-		boost::asio::io_service::work work_;
-		uint16_t transactionId_;
+		std::vector<CanMessage> &msgs_;
+		std::size_t maxMsgs_;
 		Handler handler_;
 	};
 
+	/**
+	 * Completes with all messages available at that time, up to aMaxMsgs.
+	 * The messages are stored in aMsgs, which must remain valid until the
+	 * handler is invoked.
+	 */
+	template <typename Handler>
+	void asyncGetReceivedMessages(implementation_type &impl, std::vector<CanMessage> &aMsgs,
+			std::size_t aMaxMsgs, Handler handler)
+	{
+		startReceive(impl, GetReceivedMessagesOperation<Handler>(aMsgs, aMaxMsgs, handler));
+	}
+
+	/**
+	 * Sets the maximum number of asynchronous sends handed to the adapter
+	 * and awaiting acknowledgment. Further sends are queued until a
+	 * transmission is acknowledged.
+	 */
+	void setMaxPendingSends(implementation_type &impl, std::size_t aMaxPendingSends)
+	{
+		boost::mutex::scoped_lock lock(impl->tx_mutex_);
+		impl->tx_max_pending_ = (aMaxPendingSends > 0) ? aMaxPendingSends : 1;
+		submitSends(impl);
+	}
+
+	/**
+	 * Sets the time an asynchronous send waits for its acknowledgment, once
+	 * handed to the adapter. If not acknowledged in time, the send completes
+	 * with timed_out.
+	 */
+	void setSendTimeout(implementation_type &impl, boost::posix_time::time_duration aTimeout)
+	{
+		boost::mutex::scoped_lock lock(impl->tx_mutex_);
+		impl->tx_timeout_ = aTimeout;
+	}
+
+	/**
+	 * Completes with the acknowledged message (time-stamped by the adapter),
+	 * once the adapter has confirmed the transmission.
+	 */
+	template <typename Handler>
+	void asyncSendMessage(implementation_type &impl, const SharedCanMessage &aMsg, Handler handler)
+	{
+		boost::mutex::scoped_lock lock(impl->tx_mutex_);
+		if(!impl->port_->isOpen()){
+			owner().post(boost::asio::detail::bind_handler(
+					handler, boost::asio::error::operation_aborted, SharedCanMessage()));
+			return;
+		}
+		impl->tx_queue_.push_back(std::make_pair(aMsg, SendHandler(handler)));
+		submitSends(impl);
+	}
+
 	template <typename Handler>
 	void asyncGetSendAcknMessage(implementation_type &impl, uint16_t transactionId, Handler handler)
 	{
-		this->async_io_service_2_.post(GetSendAcknMessageOperation<Handler>(impl,
-				this->get_io_service(), transactionId, handler));
+		boost::mutex::scoped_lock lock(impl->tx_mutex_);
+		if(!impl->port_->isOpen()){
+			owner().post(boost::asio::detail::bind_handler(
+					handler, boost::asio::error::operation_aborted, SharedCanMessage()));
+			return;
+		}
+		impl->tx_ackn_requests_.push_back(std::make_pair(transactionId, SendHandler(handler)));
+		waitSendAcknReady(impl);
 	}
 
 private:
-	void shutdown_service()
+	boost::asio::io_service &owner()
+	{
+#if BOOST_VERSION >= 106600
+		return this->get_io_context();
+#else
+		return this->get_io_service();
+#endif
+	}
+
+	void startReceive(implementation_type &impl, ReceiveOperation aOperation)
+	{
+		boost::mutex::scoped_lock lock(impl->rx_mutex_);
+		if(!impl->port_->isOpen()){
+			ReceiveSource source(*impl->port_, impl->rx_backlog_, false);
+			aOperation(source, owner(), boost::asio::error::operation_aborted);
+			return;
+		}
+		impl->rx_operations_.push_back(aOperation);
+		serveReceive(impl);
+	}
+
+	void startIdReceive(implementation_type &impl, uint32_t aId, const SharedIdReceiver &aReceiver)
+	{
+		boost::mutex::scoped_lock lock(impl->rx_mutex_);
+		if(!impl->port_->isOpen()){
+			completeIdReceive(owner(), aReceiver, boost::asio::error::operation_aborted, SharedCanMessage());
+			return;
+		}
+		// the message may have been set aside already
+		typename std::deque<CanMessage>::iterator it;
+		for(it = impl->rx_backlog_.begin(); it != impl->rx_backlog_.end(); ++it){
+			if(it->getId() == aId){
+				completeIdReceive(owner(), aReceiver, boost::system::error_code(), CanMessage::getSharedInstance(*it));
+				impl->rx_backlog_.erase(it);
+				return;
+			}
+		}
+		impl->rx_id_receivers_[aId].push_back(aReceiver);
+		serveReceive(impl);
+	}
+
+	// must be called with rx_mutex_ held
+	static void completeIdReceive(boost::asio::io_service &aIoService, const SharedIdReceiver &aReceiver,
+			const boost::system::error_code &aError, const SharedCanMessage &aMsg)
+	{
+		boost::system::error_code ignored;
+		aReceiver->timer_.cancel(ignored);
+		aIoService.post(boost::asio::detail::bind_handler(aReceiver->handler_, aError, aMsg));
+	}
+
+	// while operations wait for messages with their identifiers, retrieves all
+	// messages from the port and routes them, setting aside those not claimed,
+	// must be called with rx_mutex_ held
+	static void routeReceived(const implementation_type &impl)
+	{
+		while(!impl->rx_id_receivers_.empty()){
+			int count = impl->port_->getReceivedMessages(impl->rx_batch_, RouteBatchSize, 0);
+			if(count <= 0){
+				break;
+			}
+			for(int i=0; i<count; i++){
+				const CanMessage &msg = impl->rx_batch_[i];
+				typename IdReceivers::iterator it = impl->rx_id_receivers_.find(msg.getId());
+				if(it != impl->rx_id_receivers_.end()){
+					completeIdReceive(impl->io_service_, it->second.front(), boost::system::error_code(),
+							CanMessage::getSharedInstance(msg));
+					it->second.pop_front();
+					if(it->second.empty()){
+						impl->rx_id_receivers_.erase(it);
+					}
+				} else {
+					if(impl->rx_backlog_.size() == MaxReceiveBacklog){
+						impl->rx_backlog_.pop_front();
+					}
+					impl->rx_backlog_.push_back(msg);
+				}
+			}
+		}
+	}
+
+	// routes messages by identifier, then completes queued operations in order,
+	// must be called with rx_mutex_ held
+	void serveReceive(const implementation_type &impl)
+	{
+		routeReceived(impl);
+		ReceiveSource source(*impl->port_, impl->rx_backlog_, !impl->rx_id_receivers_.empty());
+		while(!impl->rx_operations_.empty()){
+			if(!impl->rx_operations_.front()(source, impl->io_service_, boost::system::error_code())){
+				break;
+			}
+			impl->rx_operations_.pop_front();
+		}
+		waitReceiveReady(impl);
+	}
+
+	// must be called with rx_mutex_ held
+	void waitReceiveReady(const implementation_type &impl)
+	{
+		if(impl->rx_operations_.empty() && impl->rx_id_receivers_.empty()){
+			return;
+		}
+		impl->rx_waiter_.asyncWait(boost::bind(&CanAsyncService::handleReceiveReady, this,
+				boost::weak_ptr<implementation>(impl), _1, _2));
+	}
+
+	void handleReceiveReady(boost::weak_ptr<implementation> aImpl, unsigned int aGeneration,
+			const boost::system::error_code &ec)
+	{
+		implementation_type impl = aImpl.lock();
+		if(!impl){
+			return;
+		}
+		boost::mutex::scoped_lock lock(impl->rx_mutex_);
+		if(!impl->rx_waiter_.complete(aGeneration, ec)){
+			// wait was started before the port was closed (or re-opened)
+			return;
+		}
+		if(!impl->port_->isOpen()){
+			abortReceive(impl);
+			return;
+		}
+		serveReceive(impl);
+	}
+
+	void handleReceiveTimeout(boost::weak_ptr<implementation> aImpl, TimedReceiveOperation aOperation,
+			const boost::system::error_code &ec)
+	{
+		implementation_type impl = aImpl.lock();
+		if(ec || !impl){
+			// completed in time
+			return;
+		}
+		boost::mutex::scoped_lock lock(impl->rx_mutex_);
+		ReceiveSource source(*impl->port_, impl->rx_backlog_, false);
+		aOperation(source, impl->io_service_, boost::asio::error::timed_out);
+		typename std::deque<ReceiveOperation>::iterator it;
+		for(it = impl->rx_operations_.begin(); it != impl->rx_operations_.end(); ++it){
+			TimedReceiveOperation *operation = it->template target<TimedReceiveOperation>();
+			if(operation && (*operation == aOperation)){
+				impl->rx_operations_.erase(it);
+				break;
+			}
+		}
+		if(impl->rx_operations_.empty() && impl->rx_id_receivers_.empty()){
+			// nothing left to wait for
+			impl->rx_waiter_.cancel();
+		}
+	}
+
+	void handleIdReceiveTimeout(boost::weak_ptr<implementation> aImpl, uint32_t aId,
+			SharedIdReceiver aReceiver, const boost::system::error_code &ec)
+	{
+		implementation_type impl = aImpl.lock();
+		if(ec || !impl){
+			// completed in time
+			return;
+		}
+		boost::mutex::scoped_lock lock(impl->rx_mutex_);
+		typename IdReceivers::iterator it = impl->rx_id_receivers_.find(aId);
+		if(it == impl->rx_id_receivers_.end()){
+			return;
+		}
+		typename std::deque<SharedIdReceiver>::iterator receiver =
+				std::find(it->second.begin(), it->second.end(), aReceiver);
+		if(receiver == it->second.end()){
+			return;
+		}
+		impl->io_service_.post(boost::asio::detail::bind_handler(
+				aReceiver->handler_, boost::asio::error::timed_out, SharedCanMessage()));
+		it->second.erase(receiver);
+		if(it->second.empty()){
+			impl->rx_id_receivers_.erase(it);
+		}
+		if(impl->rx_operations_.empty() && impl->rx_id_receivers_.empty()){
+			// nothing left to wait for
+			impl->rx_waiter_.cancel();
+		}
+	}
+
+	// must be called with rx_mutex_ held
+	static void abortReceive(const implementation_type &impl)
 	{
-		async_work_1_.reset();
-		async_io_service_1_.stop();
-		async_thread_1_.join();
+		impl->rx_waiter_.close();
+		ReceiveSource source(*impl->port_, impl->rx_backlog_, false);
+		while(!impl->rx_operations_.empty()){
+			impl->rx_operations_.front()(source, impl->io_service_, boost::asio::error::operation_aborted);
+			impl->rx_operations_.pop_front();
+		}
+		typename IdReceivers::iterator it;
+		for(it = impl->rx_id_receivers_.begin(); it != impl->rx_id_receivers_.end(); ++it){
+			while(!it->second.empty()){
+				completeIdReceive(impl->io_service_, it->second.front(), boost::asio::error::operation_aborted,
+						SharedCanMessage());
+				it->second.pop_front();
+			}
+		}
+		impl->rx_id_receivers_.clear();
+		impl->rx_backlog_.clear();
+	}
 
-		async_work_2_.reset();
-		async_io_service_2_.stop();
-		async_thread_2_.join();
+	// hands queued sends to the transmit thread, must be called with tx_mutex_ held
+	void submitSends(const implementation_type &impl)
+	{
+		while(!impl->tx_queue_.empty()
+				&& ((impl->tx_num_submitted_ + impl->tx_num_pending_) < impl->tx_max_pending_)){
+			impl->tx_num_submitted_++;
+			impl->tx_strand_.post(boost::bind(&CanAsyncService::transmit, this,
+					boost::weak_ptr<implementation>(impl), impl->tx_epoch_,
+					impl->tx_queue_.front().first, impl->tx_queue_.front().second,
+					boost::asio::io_service::work(impl->io_service_)));
+			impl->tx_queue_.pop_front();
+		}
 	}
 
-	boost::asio::io_service async_io_service_1_;
-	boost::scoped_ptr<boost::asio::io_service::work> async_work_1_;
-	boost::thread async_thread_1_;
+	// runs on a transmit thread, as sending may block until the adapter responds,
+	// the work object (only passed, never used) keeps the owning io_service busy
+	// until the transmission is pending
+	void transmit(boost::weak_ptr<implementation> aImpl, unsigned int aEpoch,
+			SharedCanMessage aMsg, SendHandler aHandler, boost::asio::io_service::work /*aWork*/)
+	{
+		implementation_type impl = aImpl.lock();
+		if(!impl){
+			owner().post(boost::asio::detail::bind_handler(
+					aHandler, boost::asio::error::operation_aborted, SharedCanMessage()));
+			return;
+		}
+		boost::mutex::scoped_lock portLock(impl->port_mutex_);
+		{
+			boost::mutex::scoped_lock lock(impl->tx_mutex_);
+			if(aEpoch != impl->tx_epoch_){
+				impl->io_service_.post(boost::asio::detail::bind_handler(
+						aHandler, boost::asio::error::operation_aborted, SharedCanMessage()));
+				return;
+			}
+		}
+		uint16_t transactionId = 0;
+		bool sent = impl->port_->sendMessage(aMsg, &transactionId);
+
+		boost::mutex::scoped_lock lock(impl->tx_mutex_);
+		impl->tx_num_submitted_--;
+		if(!sent){
+			impl->io_service_.post(boost::asio::detail::bind_handler(
+					aHandler, boost::system::errc::make_error_code(boost::system::errc::io_error),
+					SharedCanMessage()));
+		} else if(!claimUnclaimed(impl, transactionId, aHandler)){
+			boost::shared_ptr<boost::asio::deadline_timer> timer(new boost::asio::deadline_timer(impl->io_service_));
+			timer->expires_from_now(impl->tx_timeout_);
+			timer->async_wait(boost::bind(&CanAsyncService::handleSendTimeout, this,
+					boost::weak_ptr<implementation>(impl), timer, _1));
+			impl->tx_pending_[transactionId].push_back(PendingSend(aHandler, timer));
+			impl->tx_num_pending_++;
+		}
+		if(impl->tx_num_submitted_ == 0){
+			// remaining acknowledgments belong to messages not sent by the service
+			impl->tx_unclaimed_.clear();
+		}
+		submitSends(impl);
+		waitSendAcknReady(impl);
+	}
+
+	// completes send with acknowledgment received before its transaction id was
+	// known, must be called with tx_mutex_ held
+	static bool claimUnclaimed(const implementation_type &impl, uint16_t aTransactionId, SendHandler &aHandler)
+	{
+		typename std::deque<SharedCanMessage>::iterator it;
+		for(it = impl->tx_unclaimed_.begin(); it != impl->tx_unclaimed_.end(); ++it){
+			if((*it)->getTransactionId() == aTransactionId){
+				impl->io_service_.post(boost::asio::detail::bind_handler(
+						aHandler, boost::system::error_code(), *it));
+				impl->tx_unclaimed_.erase(it);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void handleSendTimeout(boost::weak_ptr<implementation> aImpl,
+			boost::shared_ptr<boost::asio::deadline_timer> aTimer, const boost::system::error_code &ec)
+	{
+		implementation_type impl = aImpl.lock();
+		if(ec || !impl){
+			// acknowledged in time
+			return;
+		}
+		boost::mutex::scoped_lock lock(impl->tx_mutex_);
+		typename PendingSends::iterator it;
+		for(it = impl->tx_pending_.begin(); it != impl->tx_pending_.end(); ++it){
+			typename std::deque<PendingSend>::iterator send;
+			for(send = it->second.begin(); send != it->second.end(); ++send){
+				if(send->timer_ == aTimer){
+					impl->io_service_.post(boost::asio::detail::bind_handler(
+							send->handler_, boost::asio::error::timed_out, SharedCanMessage()));
+					it->second.erase(send);
+					if(it->second.empty()){
+						impl->tx_pending_.erase(it);
+					}
+					impl->tx_num_pending_--;
+					submitSends(impl);
+					if(impl->tx_pending_.empty() && impl->tx_ackn_requests_.empty()){
+						// nothing left to wait for
+						impl->tx_waiter_.cancel();
+					}
+					return;
+				}
+			}
+		}
+	}
+
+	// must be called with tx_mutex_ held
+	void waitSendAcknReady(const implementation_type &impl)
+	{
+		if(impl->tx_pending_.empty() && impl->tx_ackn_requests_.empty()){
+			return;
+		}
+		impl->tx_waiter_.asyncWait(boost::bind(&CanAsyncService::handleSendAcknReady, this,
+				boost::weak_ptr<implementation>(impl), _1, _2));
+	}
+
+	void handleSendAcknReady(boost::weak_ptr<implementation> aImpl, unsigned int aGeneration,
+			const boost::system::error_code &ec)
+	{
+		implementation_type impl = aImpl.lock();
+		if(!impl){
+			return;
+		}
+		boost::mutex::scoped_lock lock(impl->tx_mutex_);
+		if(!impl->tx_waiter_.complete(aGeneration, ec)){
+			return;
+		}
+		if(!impl->port_->isOpen()){
+			abortSend(impl);
+			return;
+		}
+		SharedCanMessage ackn;
+		while((!impl->tx_pending_.empty() || !impl->tx_ackn_requests_.empty())
+				&& impl->port_->getSendAcknMessage(ackn, 0, 0)){
+			dispatchSendAckn(impl, ackn);
+		}
+		submitSends(impl);
+		waitSendAcknReady(impl);
+	}
+
+	// must be called with tx_mutex_ held
+	static void dispatchSendAckn(const implementation_type &impl, const SharedCanMessage &aAckn)
+	{
+		uint16_t transactionId = aAckn->getTransactionId();
+		bool claimed = false;
+		typename PendingSends::iterator it = impl->tx_pending_.find(transactionId);
+		if(it != impl->tx_pending_.end()){
+			// oldest send with that transaction id
+			PendingSend &send = it->second.front();
+			boost::system::error_code ignored;
+			send.timer_->cancel(ignored);
+			impl->io_service_.post(boost::asio::detail::bind_handler(
+					send.handler_, boost::system::error_code(), aAckn));
+			it->second.pop_front();
+			if(it->second.empty()){
+				impl->tx_pending_.erase(it);
+			}
+			impl->tx_num_pending_--;
+			claimed = true;
+		}
+		typename std::deque<std::pair<uint16_t, SendHandler> >::iterator req;
+		for(req = impl->tx_ackn_requests_.begin(); req != impl->tx_ackn_requests_.end(); ++req){
+			if((req->first == 0) || (req->first == transactionId)){
+				impl->io_service_.post(boost::asio::detail::bind_handler(
+						req->second, boost::system::error_code(), aAckn));
+				impl->tx_ackn_requests_.erase(req);
+				break;
+			}
+		}
+		if(!claimed && (impl->tx_num_submitted_ > 0)){
+			// may belong to a send whose transaction id is not known yet
+			impl->tx_unclaimed_.push_back(aAckn);
+		}
+	}
+
+	// must be called with tx_mutex_ held
+	static void abortSend(const implementation_type &impl)
+	{
+		impl->tx_waiter_.close();
+		impl->tx_epoch_++;
+		impl->tx_num_submitted_ = 0;
+		impl->tx_unclaimed_.clear();
+		while(!impl->tx_queue_.empty()){
+			impl->io_service_.post(boost::asio::detail::bind_handler(
+					impl->tx_queue_.front().second, boost::asio::error::operation_aborted, SharedCanMessage()));
+			impl->tx_queue_.pop_front();
+		}
+		typename PendingSends::iterator it;
+		for(it = impl->tx_pending_.begin(); it != impl->tx_pending_.end(); ++it){
+			while(!it->second.empty()){
+				boost::system::error_code ignored;
+				it->second.front().timer_->cancel(ignored);
+				impl->io_service_.post(boost::asio::detail::bind_handler(
+						it->second.front().handler_, boost::asio::error::operation_aborted, SharedCanMessage()));
+				it->second.pop_front();
+			}
+		}
+		impl->tx_pending_.clear();
+		impl->tx_num_pending_ = 0;
+		while(!impl->tx_ackn_requests_.empty()){
+			impl->io_service_.post(boost::asio::detail::bind_handler(
+					impl->tx_ackn_requests_.front().second, boost::asio::error::operation_aborted, SharedCanMessage()));
+			impl->tx_ackn_requests_.pop_front();
+		}
+	}
+
+	void shutdown_service()
+	{
+		async_work_.reset();
+		async_io_service_.stop();
+		async_threads_.join_all();
+	}
 
-	boost::asio::io_service async_io_service_2_;
-	boost::scoped_ptr<boost::asio::io_service::work> async_work_2_;
-	boost::thread async_thread_2_;
+	// transmit threads
+	boost::asio::io_service async_io_service_;
+	boost::scoped_ptr<boost::asio::io_service::work> async_work_;
+	boost::thread_group async_threads_;
 };
 
 template <typename CanAsyncImplementation>
@@ -85,6 +85,13 @@ bool CanAsyncWrapper::getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTrans
 	return pimpl->mCan->getSendAcknMessage(aMsg, aTransactionId, aTimeoutMs);
 }
 
+int CanAsyncWrapper::getSendAcknEventFd(){
+    if(!pimpl->mPortIsOpen){
+    	return -1;
+    }
+	return pimpl->mCan->getSendAcknEventFd();
+}
+
 bool CanAsyncWrapper::getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs){
     if(!pimpl->mPortIsOpen){
     	return false;
@@ -92,6 +99,21 @@ bool CanAsyncWrapper::getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeo
 	return pimpl->mCan->getReceivedMessage(aMsg, aTimeoutMs);
 }
 
+int CanAsyncWrapper::getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs){
+    if(!pimpl->mPortIsOpen){
+    	aMsgs.clear();
+    	return 0;
+    }
+	return pimpl->mCan->getReceivedMessages(aMsgs, aMaxMsgs, aTimeoutMs);
+}
+
+int CanAsyncWrapper::getReceiveEventFd(){
+    if(!pimpl->mPortIsOpen){
+    	return -1;
+    }
+	return pimpl->mCan->getReceiveEventFd();
+}
+
 bool CanAsyncWrapper::sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId){
     if(!pimpl->mPortIsOpen){
     	return false;
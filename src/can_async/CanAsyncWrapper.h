@@ -38,7 +38,10 @@ public:
 	bool isOpen();
 
 	bool getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+	int getSendAcknEventFd();
 	bool getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs);
+	int getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs);
+	int getReceiveEventFd();
     bool sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId);
 
 private:
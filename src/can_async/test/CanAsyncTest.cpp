@@ -28,8 +28,8 @@
 #include "CanAsyncTest.h"
 #include "../../utils/Logger.h"
 
-CanAsyncTest::CanAsyncTest(const boost::posix_time::time_duration aRxTimeout) :
-	mIo(), mClient(mIo), mTimer(mIo),
+CanAsyncTest::CanAsyncTest(const boost::posix_time::time_duration aRxTimeout, Mode aMode) :
+	mMode(aMode), mIo(), mClient(mIo), mTimer(mIo),
 	mBackgroundThread(), mIsOpen(false), mCloseAfterRxReq(false), mRxTimeout(aRxTimeout){
 }
 
@@ -42,8 +42,10 @@ bool CanAsyncTest::start(SharedCanAdapter CanAdapter){
 	}
 	mIsOpen = true;
 	mCloseAfterRxReq = false;
-	mClient.asyncGetSendAcknMessage(0, boost::bind(&CanAsyncTest::handleSendEnd, this, _1, _2));
-	mClient.asyncGetReceivedMessage(boost::bind(&CanAsyncTest::handleReceive, this, _1, _2));
+	if(mMode != AsyncSend){
+		mClient.asyncGetSendAcknMessage(0, boost::bind(&CanAsyncTest::handleSendEnd, this, _1, _2));
+	}
+	requestReceive();
 	boost::thread t(boost::bind(&boost::asio::io_service::run, &mIo));
 	mBackgroundThread.swap(t);
 
@@ -60,7 +62,7 @@ bool CanAsyncTest::start(SharedCanAdapter CanAdapter){
 
 	mTimer.expires_from_now(mRxTimeout);
 	mTimer.async_wait(boost::bind(&CanAsyncTest::checkDeadline, this, _1));
-	mClient.sendMessage(mTxMsg, (uint16_t*)0);
+	sendRequest();
 	return mIsOpen;
 }
 
@@ -95,37 +97,77 @@ void CanAsyncTest::handleSendEnd(const boost::system::error_code &ec, SharedCanM
 	}
 }
 
+void CanAsyncTest::sendRequest(){
+	if(mMode == AsyncSend){
+		mClient.asyncSendMessage(mTxMsg, boost::bind(&CanAsyncTest::handleSent, this, _1, _2));
+	} else {
+		mClient.sendMessage(mTxMsg, (uint16_t*)0);
+	}
+}
+
+void CanAsyncTest::handleSent(const boost::system::error_code &ec, SharedCanMessage aMsg){
+	if(ec){
+		// most likely this means that operation has been cancelled
+	} else {
+	    std::cout << "CAN msg sent (async): " << aMsg << " - @" << aMsg->getTimeStamp() << std::endl << std::flush;
+	}
+}
+
+void CanAsyncTest::requestReceive(){
+	if(mMode == BatchedReceive){
+		mClient.asyncGetReceivedMessages(mRxMsgs, MaxRxBatch, boost::bind(&CanAsyncTest::handleReceiveBatch, this, _1, _2));
+	} else {
+		mClient.asyncGetReceivedMessage(boost::bind(&CanAsyncTest::handleReceive, this, _1, _2));
+	}
+}
+
 void CanAsyncTest::handleReceive(const boost::system::error_code &ec, SharedCanMessage aMsg){
 	if(ec){
 		// most likely this means that operation has been cancelled
 	} else {
-		if(mTimer.expires_at(boost::posix_time::pos_infin) > 0){
-	    	// timer was cancelled/re-scheduled in time
-	    	mTimer.async_wait(boost::bind(&CanAsyncTest::checkDeadline, this, _1));
+		mRxMsgs.assign(1, *aMsg);
+		processReceived(1);
+	}
+}
+
+void CanAsyncTest::handleReceiveBatch(const boost::system::error_code &ec, std::size_t aNumMsgs){
+	if(ec){
+		// most likely this means that operation has been cancelled
+	} else {
+		processReceived(aNumMsgs);
+	}
+}
+
+void CanAsyncTest::processReceived(std::size_t aNumMsgs){
+	if(mTimer.expires_at(boost::posix_time::pos_infin) > 0){
+    	// timer was cancelled/re-scheduled in time
+    	mTimer.async_wait(boost::bind(&CanAsyncTest::checkDeadline, this, _1));
+	} else {
+		// too late - timer event handler already queued...
+	}
+	bool respond = (mRxCounter < 10);
+	mRxCounter += aNumMsgs;
+	if(mIsOpen){
+		if(respond){
+		    boost::posix_time::ptime mst2 = boost::posix_time::microsec_clock::local_time();
+		    boost::posix_time::time_duration msdiff = mst2 - mStartTime;
+		    mStartTime = mst2;
+		    for(std::size_t i=0; i<aNumMsgs; i++){
+		    	std::cout << "CAN msg received: " << mRxMsgs[i] << " - @" << mRxMsgs[i].getTimeStamp() << " - Time elapsed [ms]: " << (msdiff.total_milliseconds()) << std::endl << std::flush;
+		    }
+		    if(mTimer.expires_from_now(mRxTimeout) > 0){
+		    	// timer was cancelled/re-scheduled in time
+		    	mTimer.async_wait(boost::bind(&CanAsyncTest::checkDeadline, this, _1));
+		    } else {
+				// too late - timer event handler already queued...
+		    }
+		    sendRequest();
+		    requestReceive();
+		} else if (!mCloseAfterRxReq){
+			requestReceive();
 		} else {
-			// too late - timer event handler already queued...
-		}
-		mRxCounter++;
-		if(mIsOpen){
-			if(mRxCounter < 10){
-			    boost::posix_time::ptime mst2 = boost::posix_time::microsec_clock::local_time();
-			    boost::posix_time::time_duration msdiff = mst2 - mStartTime;
-			    mStartTime = mst2;
-			    std::cout << "CAN msg received: " << aMsg << " - @" << aMsg->getTimeStamp() << " - Time elapsed [ms]: " << (msdiff.total_milliseconds()) << std::endl << std::flush;;
-			    if(mTimer.expires_from_now(mRxTimeout) > 0){
-			    	// timer was cancelled/re-scheduled in time
-			    	mTimer.async_wait(boost::bind(&CanAsyncTest::checkDeadline, this, _1));
-			    } else {
-					// too late - timer event handler already queued...
-			    }
-			    mClient.sendMessage(mTxMsg, (uint16_t*)0);
-			    mClient.asyncGetReceivedMessage(boost::bind(&CanAsyncTest::handleReceive, this, _1, _2));
-			} else if (!mCloseAfterRxReq){
-				mClient.asyncGetReceivedMessage(boost::bind(&CanAsyncTest::handleReceive, this, _1, _2));
-			} else {
-				mClient.close();
-				mTimer.cancel();
-			}
+			mClient.close();
+			mTimer.cancel();
 		}
 	}
 }
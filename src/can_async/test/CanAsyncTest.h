@@ -21,6 +21,8 @@
 #ifndef CAN_ASYNC_TEST_H_
 #define CAN_ASYNC_TEST_H_
 
+#include <vector>
+
 #include <boost/asio.hpp>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/thread/thread.hpp>
@@ -32,7 +34,13 @@
 
 class CanAsyncTest {
 public:
-	CanAsyncTest(const boost::posix_time::time_duration aRxTimeout);
+	enum Mode {
+		SingleReceive = 0, // one message per receive operation
+		BatchedReceive = 1, // all available messages per receive operation
+		AsyncSend = 2 // messages sent with asyncSendMessage, one message per receive operation
+	};
+
+	CanAsyncTest(const boost::posix_time::time_duration aRxTimeout, Mode aMode = SingleReceive);
 	virtual ~CanAsyncTest();
 
 	bool start(SharedCanAdapter aCanAdapter);
@@ -40,11 +48,22 @@ public:
 	void stop();
 
 private:
+	enum {
+		MaxRxBatch = 64
+	};
+
+	void requestReceive();
 	void handleReceive(const boost::system::error_code &ec, SharedCanMessage aMsg);
+	void handleReceiveBatch(const boost::system::error_code &ec, std::size_t aNumMsgs);
+	void processReceived(std::size_t aNumMsgs);
+	void sendRequest();
 	void handleSendEnd(const boost::system::error_code &ec, SharedCanMessage aMsg);
+	void handleSent(const boost::system::error_code &ec, SharedCanMessage aMsg);
 	void checkDeadline(const boost::system::error_code &ec);
 
+	Mode mMode;
 	SharedCanMessage mTxMsg;
+	std::vector<CanMessage> mRxMsgs;
 	int mRxCounter;
 	boost::posix_time::ptime mStartTime;
 
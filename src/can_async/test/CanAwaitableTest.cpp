@@ -0,0 +1,185 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2017 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Test of the C++20 coroutine interface, requires a compiler with co_await support.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <utility>
+
+#include <boost/asio.hpp>
+#include <boost/scope_exit.hpp>
+#include <boost/system/system_error.hpp>
+
+#include "../../utils/Logger.h"
+
+#include "../../can/CanMessage.h"
+#include "../../can/CanAdapter.h"
+
+#include "../CanAsyncAwaitable.hpp"
+
+#if !defined(BOOST_ASIO_HAS_CO_AWAIT)
+#error "coroutine support required"
+#endif
+
+struct TestResult {
+	int responses;
+	int timeouts;
+	int unclaimed; // responses delivered to receive()
+	int others;
+	bool testerDone;
+};
+
+boost::asio::awaitable<void> testerPresent(CanAwaitableIoObject<> &can, int aCount, TestResult &aResult){
+	SharedCanMessage txMsg = CanMessage::getSharedInstance(0x770, 8);
+	txMsg->setData(0, 0x02);
+	txMsg->setData(1, 0x3E);
+	txMsg->setData(2, 0x00);
+	for(int i=3; i<8; i++){
+		txMsg->setData(i, 0xFF);
+	}
+
+	for(int i=0; i<aCount; i++){
+		SharedCanMessage ackn = co_await can.send(txMsg);
+		LOG(logINFO) << "Sent: " << ackn;
+		try {
+			SharedCanMessage rxMsg = co_await can.receiveFor(0x778, std::chrono::milliseconds(2000));
+			LOG(logINFO) << "Received response: " << rxMsg;
+			aResult.responses++;
+		} catch(const boost::system::system_error &e){
+			if(e.code() != boost::asio::error::timed_out){
+				throw;
+			}
+			LOG(logINFO) << "Response timed out";
+			aResult.timeouts++;
+		}
+	}
+
+	// response not waited for by identifier, to be delivered to receive()
+	co_await can.send(txMsg);
+	aResult.testerDone = true;
+}
+
+// receives all messages not claimed by the tester
+boost::asio::awaitable<void> monitor(CanAwaitableIoObject<> &can, TestResult &aResult){
+	for(;;){
+		try {
+			SharedCanMessage rxMsg = co_await can.receive(std::chrono::milliseconds(500));
+			LOG(logINFO) << "Received: " << rxMsg;
+			if(rxMsg->getId() == 0x778){
+				aResult.unclaimed++;
+			} else {
+				aResult.others++;
+			}
+		} catch(const boost::system::system_error &e){
+			if(e.code() != boost::asio::error::timed_out){
+				throw;
+			}
+			if(aResult.testerDone){
+				break;
+			}
+		}
+	}
+	can.close();
+}
+
+int main(int argc, char* argv[])
+{
+	Logger *log = Logger::Instance();
+	BOOST_SCOPE_EXIT(&log)
+	{
+		delete log;
+	} BOOST_SCOPE_EXIT_END
+
+	Logger::ReportingLevel() = logINFO;
+	LOG(logINFO) << "Testing Awaitable CAN";
+
+	CanAdapter::CanAdapterType type = CanAdapter::SLCan;
+
+	// attempt to configure and open port
+	SharedCanAdapter adapter = CanAdapter::getInstance(type, "COM48");
+	//SharedCanAdapter adapter = CanAdapter::getInstance(type, "/dev/cu.usbserial-LW1ZP54X");
+	//SharedCanAdapter adapter = CanAdapter::getInstance(type, "can0");
+
+	if(!adapter->setBaudRate(500000)){
+		LOG(logERROR) << "Unable to set baudrate";
+		return EXIT_FAILURE;
+	}
+
+	// messages of other nodes (0x770..0x77F) are received as well
+	if(!adapter->setAcceptanceFilter(0, 0x770, 0x7F0, false)){
+		LOG(logERROR) << "Unable to configure filter";
+		return EXIT_FAILURE;
+	}
+
+	if(!adapter->open()){
+		LOG(logERROR) << "Unable to open port";
+		return EXIT_FAILURE;
+	}
+
+	if(!adapter->goBusOn()){
+		LOG(logERROR) << "Unable to go bus-on";
+		return EXIT_FAILURE;
+	}
+
+	boost::asio::io_service io;
+	CanAwaitableIoObject<> can(io);
+	if(!can.open(adapter)){
+		LOG(logERROR) << "Unable to start test";
+		return EXIT_FAILURE;
+	}
+
+	bool failed = false;
+	TestResult result = { 0, 0, 0, 0, false };
+	auto completion = [&failed](std::exception_ptr e){
+		if(e){
+			try {
+				std::rethrow_exception(e);
+			} catch(const std::exception &ex){
+				LOG(logERROR) << "Test failed: " << ex.what();
+			}
+			failed = true;
+		}
+	};
+	boost::asio::co_spawn(io, testerPresent(can, 20, result), completion);
+	boost::asio::co_spawn(io, monitor(can, result), completion);
+	io.run();
+
+	adapter->close();
+	LOG(logINFO) << "Responses: " << result.responses << ", timeouts: " << result.timeouts
+			<< ", unclaimed responses: " << result.unclaimed << ", other messages: " << result.others;
+
+	// only responses not waited for (in time) by identifier are delivered to receive()
+	if(result.unclaimed > result.timeouts + 1){
+		LOG(logERROR) << "Response delivered to receive() instead of receiveFor()";
+		failed = true;
+	}
+	if((result.responses > 0) && (result.unclaimed == 0)){
+		LOG(logERROR) << "Response not claimed by receiveFor() was not delivered to receive()";
+		failed = true;
+	}
+	LOG(logINFO) << "Test done.";
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
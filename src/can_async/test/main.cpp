@@ -89,13 +89,17 @@ int main(int argc, char* argv[])
 		return EXIT_FAILURE;
 	}
 
-	CanAsyncTest test(boost::posix_time::milliseconds(2000));
-	if(!test.start(can)){
-		LOG(logERROR) << "Unable to start test";
-		return EXIT_FAILURE;
-	}
+	const CanAsyncTest::Mode modes[] = {CanAsyncTest::SingleReceive, CanAsyncTest::BatchedReceive, CanAsyncTest::AsyncSend};
+	for(std::size_t i=0; i<sizeof(modes)/sizeof(modes[0]); i++){
+		LOG(logINFO) << "Test mode: " << modes[i];
+		CanAsyncTest test(boost::posix_time::milliseconds(2000), modes[i]);
+		if(!test.start(can)){
+			LOG(logERROR) << "Unable to start test";
+			return EXIT_FAILURE;
+		}
 
-	test.stopAfterReceive();
+		test.stopAfterReceive();
+	}
 	LOG(logINFO) << "Test done.";
 
 	return EXIT_SUCCESS;
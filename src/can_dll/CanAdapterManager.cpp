@@ -55,7 +55,7 @@ int CanAdapterManager::handleExists(int aHandle){
 	return mHandleMgr.isValid(aHandle);
 }
 
-SharedCanAdapter& CanAdapterManager::adapter(int aHandle){
+SharedCanAdapter CanAdapterManager::adapter(int aHandle){
 	return mHandleMgr[aHandle];
 }
 
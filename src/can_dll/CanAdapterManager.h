@@ -40,7 +40,7 @@ public:
 	void releaseHandle(int aHandle);
 	void releaseAllHandles();
 
-	SharedCanAdapter& adapter(int aHandle);
+	SharedCanAdapter adapter(int aHandle);
 
 private:
 	HandleManager<SharedCanAdapter> mHandleMgr;
@@ -24,6 +24,7 @@
 #ifdef SCONS_TARGET_WIN
 #include <windows.h>
 #endif
+#include <string.h>
 #include <vector>
 
 #include "CanPort.h"
@@ -38,20 +39,40 @@ public:
 	CanDllPort(CanDllWrapper *aWrapper, int aHandle);
 	virtual ~CanDllPort();
 
+	// shared pointer variants (see CanPort)
+	using CanPort::sendMessage;
+	using CanPort::getReceivedMessage;
+	using CanPort::getSendAcknMessage;
+
+	/* Interface implementation */
+	bool sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId);
+
 	/* Interface implementation */
-	bool sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId);
+	int sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId);
 
 	/* Interface implementation */
 	int numReceivedMessagesAvailable();
 
 	/* Interface implementation */
-	bool getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs);
+	bool getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs);
+
+	/* Interface implementation */
+	int getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs);
+
+	/* Interface implementation */
+	bool getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs);
+
+	/**
+	 * Get file descriptor signaling received messages (see CanAdapter).
+	 * @return file descriptor, -1 if not supported
+	 */
+	int getReceiveEventFd();
 
 	/* Interface implementation */
 	int numSendAcknMessagesAvailable();
 
 	/* Interface implementation */
-	bool getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+	bool getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
 
 	/* Interface implementation */
 	int getErrorCode();
@@ -63,6 +84,9 @@ public:
 	void getErrorCounters(int *aTxErrorCounter, int *aRxErrorCounter);
 
 private:
+	static void toDllMessage(const CanMessage &aMsg, CAN_CanMessageFD &aDllMsg);
+	static void fromDllMessage(const CAN_CanMessageFD &aDllMsg, CanMessage &aMsg);
+
 	CanDllWrapper *mWrapper;
 	int mHandle;
 
@@ -75,51 +99,112 @@ mWrapper(aWrapper), mHandle(mHandle){
 inline CanDllPort::~CanDllPort(){
 }
 
-inline bool CanDllPort::sendMessage(SharedCanMessage aMsg, uint32_t aTimeoutMs){
-	CAN_CanMessage m;
-	m.id = aMsg->getId();
-	m.flags = 0;
-	if(aMsg->isExtended()){
-		m.flags |= CAN_FLAG_IS_EXTENDED;
+inline void CanDllPort::toDllMessage(const CanMessage &aMsg, CAN_CanMessageFD &aDllMsg){
+	aDllMsg.version = CAN_MESSAGE_FD_VERSION;
+	aDllMsg.id = aMsg.getId();
+	aDllMsg.flags = 0;
+	if(aMsg.isExtended()){
+		aDllMsg.flags |= CAN_FLAG_IS_EXTENDED;
 	}
-	m.len = aMsg->getId();
-	for(int i=0; i<aMsg->getId(); i++){
-		m.data[i] = aMsg->getData(i);
+	if(aMsg.isFd()){
+		aDllMsg.flags |= CAN_FLAG_IS_FD;
+		if(aMsg.hasBitRateSwitch()){
+			aDllMsg.flags |= CAN_FLAG_BRS;
+		}
+		if(aMsg.hasErrorStateIndicator()){
+			aDllMsg.flags |= CAN_FLAG_ESI;
+		}
 	}
-	return (mWrapper->sendMessage(mHandle, &m, aTimeoutMs) == 1);
+	aDllMsg.len = aMsg.getLen();
+	memcpy(aDllMsg.data, aMsg.getDataPtr(), aMsg.getLen());
+	aDllMsg.timestamp = aMsg.getTimeStampNs();
+}
+
+inline void CanDllPort::fromDllMessage(const CAN_CanMessageFD &aDllMsg, CanMessage &aMsg){
+	aMsg = CanMessage(aDllMsg.id, aDllMsg.len, (aDllMsg.flags & CAN_FLAG_IS_EXTENDED), aDllMsg.timestamp);
+	aMsg.setFd((aDllMsg.flags & CAN_FLAG_IS_FD), (aDllMsg.flags & CAN_FLAG_BRS), (aDllMsg.flags & CAN_FLAG_ESI));
+	memcpy(aMsg.getDataPtr(), aDllMsg.data, aDllMsg.len);
+}
+
+inline bool CanDllPort::sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId){
+	CAN_CanMessageFD m;
+	toDllMessage(aMsg, m);
+	return (mWrapper->sendMessageFD(mHandle, &m, aTransactionId) == 1);
+}
+
+inline int CanDllPort::sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId){
+	if(aMsgs.empty()){
+		return 0;
+	}
+	std::vector<CAN_CanMessageFD> msgs(aMsgs.size());
+	for(std::size_t i=0; i<aMsgs.size(); i++){
+		toDllMessage(aMsgs[i], msgs[i]);
+	}
+	return mWrapper->sendMessagesFD(mHandle, &msgs[0], (int)msgs.size(), aFirstTransactionId);
 }
 
 inline int CanDllPort::numReceivedMessagesAvailable(){
 	return mWrapper->numReceivedMessagesAvailable(mHandle);
 }
 
-inline bool CanDllPort::getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs){
-	CAN_CanMessage msgS;
-	if(mWrapper->getReceivedMessage(mHandle, &msgS, aTimeoutMs) == 0){
+inline bool CanDllPort::getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs){
+	CAN_CanMessageFD msgS;
+	msgS.version = CAN_MESSAGE_FD_VERSION;
+	if(mWrapper->getReceivedMessageFD(mHandle, &msgS, aTimeoutMs) == 0){
 		return false;
 	}
+	fromDllMessage(msgS, aMsg);
+	return true;
+}
 
-	aMsg = CanMessage::getSharedInstance(msgS.id, msgS.len, (msgS.flags & CAN_FLAG_IS_EXTENDED));
-	for(int i=0; i<msgS.len; i++){
-		aMsg->setData(i, msgS.data[i]);
+inline int CanDllPort::getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs){
+	aMsgs.clear();
+	// messages are retrieved in chunks on the stack, only the first call waits
+	const std::size_t ChunkSize = 32;
+	CAN_CanMessageFD msgs[ChunkSize];
+	CanMessage msg;
+	uint32_t timeoutMs = aTimeoutMs;
+	while(aMsgs.size() < aMaxMsgs){
+		std::size_t max = ((aMaxMsgs - aMsgs.size()) < ChunkSize) ? (aMaxMsgs - aMsgs.size()) : ChunkSize;
+		msgs[0].version = CAN_MESSAGE_FD_VERSION;
+		int n = mWrapper->getReceivedMessagesFD(mHandle, msgs, (int)max, timeoutMs);
+		for(int i=0; i<n; i++){
+			fromDllMessage(msgs[i], msg);
+			aMsgs.push_back(msg);
+		}
+		if((n < 0) || ((std::size_t)n < max)){
+			break;
+		}
+		timeoutMs = 0;
 	}
+	return (int)aMsgs.size();
+}
+
+inline bool CanDllPort::getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+	CAN_CanMessageFD msgS;
+	msgS.version = CAN_MESSAGE_FD_VERSION;
+	if(mWrapper->getReceivedMessageMatchingFD(mHandle, &msgS, aIdCode, aIdMask, aTimeoutMs) == 0){
+		return false;
+	}
+	fromDllMessage(msgS, aMsg);
 	return true;
 }
 
+inline int CanDllPort::getReceiveEventFd(){
+	return mWrapper->getReceiveEventFd(mHandle);
+}
+
 inline int CanDllPort::numSendAcknMessagesAvailable(){
 	return mWrapper->numSendAcknMessagesAvailable(mHandle);
 }
 
-inline bool CanDllPort::getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
-	CAN_CanMessage msgS;
-	if(mWrapper->getSendAcknMessage(mHandle, &msgS, aTransactionId, aTimeoutMs) == 0){
+inline bool CanDllPort::getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
+	CAN_CanMessageFD msgS;
+	msgS.version = CAN_MESSAGE_FD_VERSION;
+	if(mWrapper->getSendAcknMessageFD(mHandle, &msgS, aTransactionId, aTimeoutMs) == 0){
 		return false;
 	}
-
-	aMsg = CanMessage::getSharedInstance(msgS.id, msgS.len, (msgS.flags & CAN_FLAG_IS_EXTENDED));
-	for(int i=0; i<msgS.len; i++){
-		aMsg->setData(i, msgS.data[i]);
-	}
+	fromDllMessage(msgS, aMsg);
 	return true;
 }
 
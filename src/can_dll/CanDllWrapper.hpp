@@ -56,6 +56,7 @@ public:
 	void releaseAllHandles();
 
 	int setParameter(int aHandle,  const char *aKey, const char *aValue);
+	int getParameter(int aHandle, const char *aKey, char *aValue, int aValueLength);
 	int setBaudRate(int aHandle, uint32_t aBaudrate);
 	int getNumberOfFilters(int aHandle);
 	int setAcceptanceFilter(int aHandle, int aFid, uint32_t aCode, uint32_t aMask, int IsExt);
@@ -67,6 +68,17 @@ public:
 	int getReceivedMessage(int aHandle, CAN_CanMessage *aMsg, uint32_t aTimeoutMs);
 	int numSendAcknMessagesAvailable(int aHandle);
 	int getSendAcknMessage(int aHandle, CAN_CanMessage *aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+	int sendMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint16_t *aTransactionId);
+	int getReceivedMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint32_t aTimeoutMs);
+	int getSendAcknMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+	int sendMessages(int aHandle, CAN_CanMessage *aMsgs, int aNumMsgs, uint16_t *aFirstTransactionId);
+	int getReceivedMessages(int aHandle, CAN_CanMessage *aMsgs, int aMaxMsgs, uint32_t aTimeoutMs);
+	int sendMessagesFD(int aHandle, CAN_CanMessageFD *aMsgs, int aNumMsgs, uint16_t *aFirstTransactionId);
+	int getReceivedMessagesFD(int aHandle, CAN_CanMessageFD *aMsgs, int aMaxMsgs, uint32_t aTimeoutMs);
+	int getReceiveEventFd(int aHandle);
+	int setReceiveCallback(int aHandle, CAN_ReceiveCallback aCallback, void *aUser);
+	int getReceivedMessageMatching(int aHandle, CAN_CanMessage *aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs);
+	int getReceivedMessageMatchingFD(int aHandle, CAN_CanMessageFD *aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs);
 
 	void close(int aHandle);
 	int getState(int aHandle);
@@ -108,6 +120,7 @@ class CanDllWrapper_p {
 	typedef void (*DllReleaseAllHandlesFcn)();
 
 	typedef int (*DllSetParameterFcn)(int, const char*, const char*);
+	typedef int (*DllGetParameterFcn)(int, const char*, char*, int);
 	typedef int (*DllSetBaudRateFcn)(int, int);
 	typedef int (*DllGetNumberOfFiltersFcn)(int);
 	typedef int (*DllSetAcceptanceFilterFcn)(int, int, int, int, int);
@@ -119,6 +132,17 @@ class CanDllWrapper_p {
 	typedef int (*DllGetReceivedMessageFcn)(int, CAN_CanMessage*, int);
 	typedef int (*DllNumSendAcknMessagesAvailableFcn)(int);
 	typedef int (*DllGetSendAcknMessageFcn)(int, CAN_CanMessage*, uint16_t, int);
+	typedef int (*DllSendMessageFDFcn)(int, CAN_CanMessageFD*, uint16_t *);
+	typedef int (*DllGetReceivedMessageFDFcn)(int, CAN_CanMessageFD*, int);
+	typedef int (*DllGetSendAcknMessageFDFcn)(int, CAN_CanMessageFD*, uint16_t, int);
+	typedef int (*DllSendMessagesFcn)(int, CAN_CanMessage*, int, uint16_t *);
+	typedef int (*DllGetReceivedMessagesFcn)(int, CAN_CanMessage*, int, uint32_t);
+	typedef int (*DllSendMessagesFDFcn)(int, CAN_CanMessageFD*, int, uint16_t *);
+	typedef int (*DllGetReceivedMessagesFDFcn)(int, CAN_CanMessageFD*, int, uint32_t);
+	typedef int (*DllGetReceiveEventFdFcn)(int);
+	typedef int (*DllSetReceiveCallbackFcn)(int, CAN_ReceiveCallback, void*);
+	typedef int (*DllGetReceivedMessageMatchingFcn)(int, CAN_CanMessage*, uint32_t, uint32_t, uint32_t);
+	typedef int (*DllGetReceivedMessageMatchingFDFcn)(int, CAN_CanMessageFD*, uint32_t, uint32_t, uint32_t);
 	typedef void (*DllCloseFcn)(int);
 
 	typedef int (*DllGetStateFcn)(int);
@@ -146,6 +170,7 @@ public:
 	inline DllReleaseAllHandlesFcn getReleaseAllHandlesFcn() const { return mReleaseAllHandlesFcn; }
 
 	inline DllSetParameterFcn getSetParameterFcn() const { return mDllSetParameterFcn; };
+	inline DllGetParameterFcn getGetParameterFcn() const { return mGetParameterFcn; }
 	inline DllSetBaudRateFcn getSetBaudRateFcn() const { return mSetBaudRateFcn; }
 	inline DllGetNumberOfFiltersFcn getGetNumberOfFiltersFcn() const { return mGetNumberOfFiltersFcn; }
 	inline DllSetAcceptanceFilterFcn getSetAcceptanceFilterFcn() const { return mSetAcceptanceFilterFcn; }
@@ -157,6 +182,17 @@ public:
 	inline DllGetReceivedMessageFcn getGetReceivedMessageFcn() const { return mGetReceivedMessageFcn; }
 	inline DllNumSendAcknMessagesAvailableFcn getNumSendAcknMessagesAvailableFcn() const { return mNumSendAcknMessagesAvailableFcn; }
 	inline DllGetSendAcknMessageFcn getGetSendAcknMessageFcn() const { return mGetSendAcknMessageFcn; }
+	inline DllSendMessageFDFcn getSendMessageFDFcn() const { return mSendMessageFDFcn; }
+	inline DllGetReceivedMessageFDFcn getGetReceivedMessageFDFcn() const { return mGetReceivedMessageFDFcn; }
+	inline DllGetSendAcknMessageFDFcn getGetSendAcknMessageFDFcn() const { return mGetSendAcknMessageFDFcn; }
+	inline DllSendMessagesFcn getSendMessagesFcn() const { return mSendMessagesFcn; }
+	inline DllGetReceivedMessagesFcn getGetReceivedMessagesFcn() const { return mGetReceivedMessagesFcn; }
+	inline DllSendMessagesFDFcn getSendMessagesFDFcn() const { return mSendMessagesFDFcn; }
+	inline DllGetReceivedMessagesFDFcn getGetReceivedMessagesFDFcn() const { return mGetReceivedMessagesFDFcn; }
+	inline DllGetReceiveEventFdFcn getGetReceiveEventFdFcn() const { return mGetReceiveEventFdFcn; }
+	inline DllSetReceiveCallbackFcn getSetReceiveCallbackFcn() const { return mSetReceiveCallbackFcn; }
+	inline DllGetReceivedMessageMatchingFcn getGetReceivedMessageMatchingFcn() const { return mGetReceivedMessageMatchingFcn; }
+	inline DllGetReceivedMessageMatchingFDFcn getGetReceivedMessageMatchingFDFcn() const { return mGetReceivedMessageMatchingFDFcn; }
 	inline DllCloseFcn getCloseFcn() const { return mCloseFcn; }
 
 	inline DllGetStateFcn getGetStateFcn() const { return mDllGetStateFcn; }
@@ -180,6 +216,7 @@ private:
 	DllReleaseAllHandlesFcn mReleaseAllHandlesFcn;
 
 	DllSetParameterFcn mDllSetParameterFcn;
+	DllGetParameterFcn mGetParameterFcn;
 	DllSetBaudRateFcn mSetBaudRateFcn;
 	DllGetNumberOfFiltersFcn mGetNumberOfFiltersFcn;
 	DllSetAcceptanceFilterFcn mSetAcceptanceFilterFcn;
@@ -191,6 +228,17 @@ private:
 	DllGetReceivedMessageFcn mGetReceivedMessageFcn;
 	DllNumSendAcknMessagesAvailableFcn mNumSendAcknMessagesAvailableFcn;
 	DllGetSendAcknMessageFcn mGetSendAcknMessageFcn;
+	DllSendMessageFDFcn mSendMessageFDFcn;
+	DllGetReceivedMessageFDFcn mGetReceivedMessageFDFcn;
+	DllGetSendAcknMessageFDFcn mGetSendAcknMessageFDFcn;
+	DllSendMessagesFcn mSendMessagesFcn;
+	DllGetReceivedMessagesFcn mGetReceivedMessagesFcn;
+	DllSendMessagesFDFcn mSendMessagesFDFcn;
+	DllGetReceivedMessagesFDFcn mGetReceivedMessagesFDFcn;
+	DllGetReceiveEventFdFcn mGetReceiveEventFdFcn;
+	DllSetReceiveCallbackFcn mSetReceiveCallbackFcn;
+	DllGetReceivedMessageMatchingFcn mGetReceivedMessageMatchingFcn;
+	DllGetReceivedMessageMatchingFDFcn mGetReceivedMessageMatchingFDFcn;
 	DllCloseFcn mCloseFcn;
 
 	DllGetStateFcn mDllGetStateFcn;
@@ -236,6 +284,7 @@ inline int CanDllWrapper_p::loadDll(){
 		mReleaseAllHandlesFcn = (DllReleaseAllHandlesFcn)GetProcAddress((HMODULE)mHandle, "CAN_releaseAllHandles");
 
 		mDllSetParameterFcn = (DllSetParameterFcn)GetProcAddress((HMODULE)mHandle, "CAN_setParameter");
+		mGetParameterFcn = (DllGetParameterFcn)GetProcAddress((HMODULE)mHandle, "CAN_getParameter");
 		mSetBaudRateFcn = (DllSetBaudRateFcn)GetProcAddress((HMODULE)mHandle, "CAN_setBaudRate");
 		mGetNumberOfFiltersFcn = (DllGetNumberOfFiltersFcn)GetProcAddress((HMODULE)mHandle, "CAN_getNumberOfFilters");
 		mSetAcceptanceFilterFcn = (DllSetAcceptanceFilterFcn)GetProcAddress((HMODULE)mHandle, "CAN_setAcceptanceFilter");
@@ -247,6 +296,17 @@ inline int CanDllWrapper_p::loadDll(){
 		mGetReceivedMessageFcn = (DllGetReceivedMessageFcn)GetProcAddress((HMODULE)mHandle, "CAN_getReceivedMessage");
 		mNumSendAcknMessagesAvailableFcn = (DllNumSendAcknMessagesAvailableFcn)GetProcAddress((HMODULE)mHandle, "CAN_numSendAcknMessagesAvailable");
 		mGetSendAcknMessageFcn = (DllGetSendAcknMessageFcn)GetProcAddress((HMODULE)mHandle, "CAN_getSendAcknMessage");
+		mSendMessageFDFcn = (DllSendMessageFDFcn)GetProcAddress((HMODULE)mHandle, "CAN_sendMessageFD");
+		mGetReceivedMessageFDFcn = (DllGetReceivedMessageFDFcn)GetProcAddress((HMODULE)mHandle, "CAN_getReceivedMessageFD");
+		mGetSendAcknMessageFDFcn = (DllGetSendAcknMessageFDFcn)GetProcAddress((HMODULE)mHandle, "CAN_getSendAcknMessageFD");
+		mSendMessagesFcn = (DllSendMessagesFcn)GetProcAddress((HMODULE)mHandle, "CAN_sendMessages");
+		mGetReceivedMessagesFcn = (DllGetReceivedMessagesFcn)GetProcAddress((HMODULE)mHandle, "CAN_getReceivedMessages");
+		mSendMessagesFDFcn = (DllSendMessagesFDFcn)GetProcAddress((HMODULE)mHandle, "CAN_sendMessagesFD");
+		mGetReceivedMessagesFDFcn = (DllGetReceivedMessagesFDFcn)GetProcAddress((HMODULE)mHandle, "CAN_getReceivedMessagesFD");
+		mGetReceiveEventFdFcn = (DllGetReceiveEventFdFcn)GetProcAddress((HMODULE)mHandle, "CAN_getReceiveEventFd");
+		mSetReceiveCallbackFcn = (DllSetReceiveCallbackFcn)GetProcAddress((HMODULE)mHandle, "CAN_setReceiveCallback");
+		mGetReceivedMessageMatchingFcn = (DllGetReceivedMessageMatchingFcn)GetProcAddress((HMODULE)mHandle, "CAN_getReceivedMessageMatching");
+		mGetReceivedMessageMatchingFDFcn = (DllGetReceivedMessageMatchingFDFcn)GetProcAddress((HMODULE)mHandle, "CAN_getReceivedMessageMatchingFD");
 		mCloseFcn = (DllCloseFcn)GetProcAddress((HMODULE)mHandle, "CAN_close");
 
 		mDllGetStateFcn = (DllGetStateFcn)GetProcAddress((HMODULE)mHandle, "CAN_getState");
@@ -291,6 +351,7 @@ inline int CanDllWrapper_p::loadDll(){
 		mReleaseAllHandlesFcn = (DllReleaseAllHandlesFcn)dlsym(mHandle, "CAN_releaseAllHandles");
 
 		mDllSetParameterFcn = (DllSetParameterFcn)dlsym(mHandle, "CAN_setParameter");
+		mGetParameterFcn = (DllGetParameterFcn)dlsym(mHandle, "CAN_getParameter");
 		mSetBaudRateFcn = (DllSetBaudRateFcn)dlsym(mHandle, "CAN_setBaudRate");
 		mGetNumberOfFiltersFcn = (DllGetNumberOfFiltersFcn)dlsym(mHandle, "CAN_getNumberOfFilters");
 		mSetAcceptanceFilterFcn = (DllSetAcceptanceFilterFcn)dlsym(mHandle, "CAN_setAcceptanceFilter");
@@ -302,6 +363,17 @@ inline int CanDllWrapper_p::loadDll(){
 		mGetReceivedMessageFcn = (DllGetReceivedMessageFcn)dlsym(mHandle, "CAN_getReceivedMessage");
 		mNumSendAcknMessagesAvailableFcn = (DllNumSendAcknMessagesAvailableFcn)dlsym(mHandle, "CAN_numSendAcknMessagesAvailable");
 		mGetSendAcknMessageFcn = (DllGetSendAcknMessageFcn)dlsym(mHandle, "CAN_getSendAcknMessage");
+		mSendMessageFDFcn = (DllSendMessageFDFcn)dlsym(mHandle, "CAN_sendMessageFD");
+		mGetReceivedMessageFDFcn = (DllGetReceivedMessageFDFcn)dlsym(mHandle, "CAN_getReceivedMessageFD");
+		mGetSendAcknMessageFDFcn = (DllGetSendAcknMessageFDFcn)dlsym(mHandle, "CAN_getSendAcknMessageFD");
+		mSendMessagesFcn = (DllSendMessagesFcn)dlsym(mHandle, "CAN_sendMessages");
+		mGetReceivedMessagesFcn = (DllGetReceivedMessagesFcn)dlsym(mHandle, "CAN_getReceivedMessages");
+		mSendMessagesFDFcn = (DllSendMessagesFDFcn)dlsym(mHandle, "CAN_sendMessagesFD");
+		mGetReceivedMessagesFDFcn = (DllGetReceivedMessagesFDFcn)dlsym(mHandle, "CAN_getReceivedMessagesFD");
+		mGetReceiveEventFdFcn = (DllGetReceiveEventFdFcn)dlsym(mHandle, "CAN_getReceiveEventFd");
+		mSetReceiveCallbackFcn = (DllSetReceiveCallbackFcn)dlsym(mHandle, "CAN_setReceiveCallback");
+		mGetReceivedMessageMatchingFcn = (DllGetReceivedMessageMatchingFcn)dlsym(mHandle, "CAN_getReceivedMessageMatching");
+		mGetReceivedMessageMatchingFDFcn = (DllGetReceivedMessageMatchingFDFcn)dlsym(mHandle, "CAN_getReceivedMessageMatchingFD");
 		mCloseFcn = (DllCloseFcn)dlsym(mHandle, "CAN_close");
 
 		mDllGetStateFcn = (DllGetStateFcn)dlsym(mHandle, "CAN_getState");
@@ -332,6 +404,7 @@ inline int CanDllWrapper_p::allPointersAreNonNull() {
 			(mReleaseAllHandlesFcn != NULL) &&
 
 			(mDllSetParameterFcn != NULL) &&
+			(mGetParameterFcn != NULL) &&
 			(mSetBaudRateFcn != NULL) &&
 			(mGetNumberOfFiltersFcn != NULL) &&
 			(mSetAcceptanceFilterFcn != NULL) &&
@@ -343,6 +416,17 @@ inline int CanDllWrapper_p::allPointersAreNonNull() {
 			(mGetReceivedMessageFcn != NULL) &&
 			(mNumSendAcknMessagesAvailableFcn != NULL) &&
 			(mGetSendAcknMessageFcn != NULL) &&
+			(mSendMessageFDFcn != NULL) &&
+			(mGetReceivedMessageFDFcn != NULL) &&
+			(mGetSendAcknMessageFDFcn != NULL) &&
+			(mSendMessagesFcn != NULL) &&
+			(mGetReceivedMessagesFcn != NULL) &&
+			(mSendMessagesFDFcn != NULL) &&
+			(mGetReceivedMessagesFDFcn != NULL) &&
+			(mGetReceiveEventFdFcn != NULL) &&
+			(mSetReceiveCallbackFcn != NULL) &&
+			(mGetReceivedMessageMatchingFcn != NULL) &&
+			(mGetReceivedMessageMatchingFDFcn != NULL) &&
 			(mCloseFcn != NULL) &&
 
 			(mDllGetStateFcn != NULL) &&
@@ -400,6 +484,10 @@ inline int CanDllWrapper::setParameter(int aHandle,  const char *aKey, const cha
 	return pimpl->getSetParameterFcn()(aHandle, aKey, aValue);
 }
 
+inline int CanDllWrapper::getParameter(int aHandle, const char *aKey, char *aValue, int aValueLength){
+	return pimpl->getGetParameterFcn()(aHandle, aKey, aValue, aValueLength);
+}
+
 inline int CanDllWrapper::setBaudRate(int aHandle, uint32_t aBaudrate){
 	return pimpl->getSetBaudRateFcn()(aHandle, aBaudrate);
 }
@@ -444,6 +532,50 @@ inline int CanDllWrapper::getSendAcknMessage(int aHandle, CAN_CanMessage *aMsg,
 	return pimpl->getGetSendAcknMessageFcn()(aHandle, aMsg, aTransactionId, aTimeoutMs);
 }
 
+inline int CanDllWrapper::sendMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint16_t *aTransactionId){
+	return pimpl->getSendMessageFDFcn()(aHandle, aMsg, aTransactionId);
+}
+
+inline int CanDllWrapper::getReceivedMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint32_t aTimeoutMs){
+	return pimpl->getGetReceivedMessageFDFcn()(aHandle, aMsg, aTimeoutMs);
+}
+
+inline int CanDllWrapper::getSendAcknMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
+	return pimpl->getGetSendAcknMessageFDFcn()(aHandle, aMsg, aTransactionId, aTimeoutMs);
+}
+
+inline int CanDllWrapper::sendMessages(int aHandle, CAN_CanMessage *aMsgs, int aNumMsgs, uint16_t *aFirstTransactionId){
+	return pimpl->getSendMessagesFcn()(aHandle, aMsgs, aNumMsgs, aFirstTransactionId);
+}
+
+inline int CanDllWrapper::getReceivedMessages(int aHandle, CAN_CanMessage *aMsgs, int aMaxMsgs, uint32_t aTimeoutMs){
+	return pimpl->getGetReceivedMessagesFcn()(aHandle, aMsgs, aMaxMsgs, aTimeoutMs);
+}
+
+inline int CanDllWrapper::sendMessagesFD(int aHandle, CAN_CanMessageFD *aMsgs, int aNumMsgs, uint16_t *aFirstTransactionId){
+	return pimpl->getSendMessagesFDFcn()(aHandle, aMsgs, aNumMsgs, aFirstTransactionId);
+}
+
+inline int CanDllWrapper::getReceivedMessagesFD(int aHandle, CAN_CanMessageFD *aMsgs, int aMaxMsgs, uint32_t aTimeoutMs){
+	return pimpl->getGetReceivedMessagesFDFcn()(aHandle, aMsgs, aMaxMsgs, aTimeoutMs);
+}
+
+inline int CanDllWrapper::getReceiveEventFd(int aHandle){
+	return pimpl->getGetReceiveEventFdFcn()(aHandle);
+}
+
+inline int CanDllWrapper::setReceiveCallback(int aHandle, CAN_ReceiveCallback aCallback, void *aUser){
+	return pimpl->getSetReceiveCallbackFcn()(aHandle, aCallback, aUser);
+}
+
+inline int CanDllWrapper::getReceivedMessageMatching(int aHandle, CAN_CanMessage *aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+	return pimpl->getGetReceivedMessageMatchingFcn()(aHandle, aMsg, aIdCode, aIdMask, aTimeoutMs);
+}
+
+inline int CanDllWrapper::getReceivedMessageMatchingFD(int aHandle, CAN_CanMessageFD *aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+	return pimpl->getGetReceivedMessageMatchingFDFcn()(aHandle, aMsg, aIdCode, aIdMask, aTimeoutMs);
+}
+
 inline void CanDllWrapper::close(int aHandle){
 	return pimpl->getCloseFcn()(aHandle);
 }
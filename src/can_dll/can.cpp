@@ -19,6 +19,10 @@
  */
 
 #include <stddef.h>
+#include <string.h>
+#include <vector>
+
+#include <boost/bind.hpp>
 
 #include "../utils/Logger.h"
 
@@ -70,6 +74,105 @@ enum CanAdapter::CanAdapterType jcConvertCanAdapterType(CAN_AdapterType aType){
 	}
 }
 
+uint16_t jcConvertCanMessageFlags(const CanMessage &aMsg){
+	uint16_t flags = 0;
+	if(aMsg.isExtended()){
+		flags |= CAN_FLAG_IS_EXTENDED;
+	}
+	if(aMsg.isFd()){
+		flags |= CAN_FLAG_IS_FD;
+		if(aMsg.hasBitRateSwitch()){
+			flags |= CAN_FLAG_BRS;
+		}
+		if(aMsg.hasErrorStateIndicator()){
+			flags |= CAN_FLAG_ESI;
+		}
+	}
+	return(flags);
+}
+
+void jcConvertCanMessage(const CanMessage &aMsg, CAN_CanMessage *aCMsg){
+	aCMsg->id = aMsg.getId();
+	// FD payload is truncated (check CAN_FLAG_IS_FD)
+	aCMsg->len = (aMsg.getLen() > 8) ? 8 : aMsg.getLen();
+	memcpy(aCMsg->data, aMsg.getDataPtr(), aCMsg->len);
+	aCMsg->flags = jcConvertCanMessageFlags(aMsg);
+	aCMsg->timestamp = aMsg.getTimeStampNs();
+}
+
+void jcConvertCanMessage(const CanMessage &aMsg, CAN_CanMessageFD *aCMsg){
+	aCMsg->id = aMsg.getId();
+	aCMsg->len = aMsg.getLen();
+	memcpy(aCMsg->data, aMsg.getDataPtr(), aMsg.getLen());
+	aCMsg->flags = jcConvertCanMessageFlags(aMsg);
+	aCMsg->timestamp = aMsg.getTimeStampNs();
+}
+
+bool jcConvertCanMessage(const CAN_CanMessage *aCMsg, CanMessage &aMsg){
+	if((aCMsg->flags & CAN_FLAG_IS_REMOTE_FRAME) || (aCMsg->len > 8)){
+		// don't know what to do with this
+		return(false);
+	}
+	aMsg = CanMessage(aCMsg->id, aCMsg->len, (aCMsg->flags & CAN_FLAG_IS_EXTENDED));
+	memcpy(aMsg.getDataPtr(), aCMsg->data, aCMsg->len);
+	return(true);
+}
+
+bool jcConvertCanMessage(const CAN_CanMessageFD *aCMsg, CanMessage &aMsg){
+	if((aCMsg->flags & CAN_FLAG_IS_REMOTE_FRAME) || (aCMsg->len > 64)){
+		return(false);
+	}
+	aMsg = CanMessage(aCMsg->id, aCMsg->len, (aCMsg->flags & CAN_FLAG_IS_EXTENDED));
+	aMsg.setFd((aCMsg->flags & CAN_FLAG_IS_FD), (aCMsg->flags & CAN_FLAG_BRS), (aCMsg->flags & CAN_FLAG_ESI));
+	memcpy(aMsg.getDataPtr(), aCMsg->data, aCMsg->len);
+	return(true);
+}
+
+// converts leading valid messages, and hands them over to the adapter in one go
+template<class T>
+int jcSendMessages(int aHandle, const T *aMsgs, int aNumMsgs, uint16_t *aFirstTransactionId){
+	std::vector<CanMessage> msgs(aNumMsgs > 0 ? aNumMsgs : 0);
+	int n = 0;
+	while((n < aNumMsgs) && jcConvertCanMessage(&aMsgs[n], msgs[n])){
+		n++;
+	}
+	if(n == 0){
+		return(0);
+	}
+	msgs.resize(n);
+	return Manager->adapter(aHandle)->sendMessages(msgs, aFirstTransactionId);
+}
+
+template<class T>
+int jcGetReceivedMessages(int aHandle, T *aMsgs, int aMaxMsgs, uint32_t aTimeoutMs){
+	if(aMaxMsgs <= 0){
+		return(0);
+	}
+	std::vector<CanMessage> msgs;
+	msgs.reserve(aMaxMsgs);
+	int n = Manager->adapter(aHandle)->getReceivedMessages(msgs, aMaxMsgs, aTimeoutMs);
+	for(int i=0; i<n; i++){
+		jcConvertCanMessage(msgs[i], &aMsgs[i]);
+	}
+	return(n);
+}
+
+// converts received messages in chunks on the stack, and passes them on to the callback
+void jcReceiveCallback(CAN_ReceiveCallback aCallback, void *aUser, const CanMessage *aMsgs, std::size_t aCount){
+	const std::size_t ChunkSize = 32;
+	CAN_CanMessageFD msgs[ChunkSize];
+	while(aCount > 0){
+		std::size_t n = (aCount < ChunkSize) ? aCount : ChunkSize;
+		for(std::size_t i=0; i<n; i++){
+			msgs[i].version = CAN_MESSAGE_FD_VERSION;
+			jcConvertCanMessage(aMsgs[i], &msgs[i]);
+		}
+		aCallback(aUser, msgs, (int)n);
+		aMsgs += n;
+		aCount -= n;
+	}
+}
+
 int CAN_getFirstChannelName(CAN_AdapterType aType, char* aString, int aStringLength){
 	enum CanAdapter::CanAdapterType type = jcConvertCanAdapterType(aType);
 
@@ -133,6 +236,17 @@ int CAN_setParameter(int aHandle, const char* aKey, const char* aValue){
 	return Manager->adapter(aHandle)->setParameter(key, value);
 }
 
+int CAN_getParameter(int aHandle, const char* aKey, char* aValue, int aValueLength){
+	std::string key(aKey);
+	std::string value;
+	if(!Manager->adapter(aHandle)->getParameter(key, value)){
+		return(0);
+	}
+	size_t len = value.copy(aValue, aValueLength-1);
+	aValue[len] = '\0';
+	return(1);
+}
+
 int CAN_setBaudRate(int aHandle, uint32_t aBaudrate){
 	return Manager->adapter(aHandle)->setBaudRate(aBaudrate);
 }
@@ -158,14 +272,10 @@ int CAN_goBusOff(int aHandle){
 }
 
 int CAN_sendMessage(int aHandle, CAN_CanMessage *aMsg, uint16_t *aTransactionId){
-	if(aMsg->flags & CAN_FLAG_IS_REMOTE_FRAME){
-		// don't know what to do with this
+	CanMessage msg;
+	if(!jcConvertCanMessage(aMsg, msg)){
 		return(false);
 	}
-	SharedCanMessage msg = CanMessage::getSharedInstance(aMsg->id, aMsg->len, (aMsg->flags & CAN_FLAG_IS_EXTENDED));
-	for(int i=0; i<aMsg->len; i++){
-		msg->setData(i, aMsg->data[i]);
-	}
 	return Manager->adapter(aHandle)->sendMessage(msg, aTransactionId);
 }
 
@@ -174,19 +284,11 @@ int CAN_numReceivedMessagesAvailable(int aHandle){
 }
 
 int CAN_getReceivedMessage(int aHandle, CAN_CanMessage *aMsg, uint32_t aTimeoutMs){
-	SharedCanMessage msg;
+	CanMessage msg;
 	if(!Manager->adapter(aHandle)->getReceivedMessage(msg, aTimeoutMs)){
 		return(false);
 	}
-	aMsg->id = msg->getId();
-	aMsg->len = msg->getLen();
-	for(int i=0; i<msg->getLen(); i++){
-		aMsg->data[i] = msg->getData(i);
-	}
-	aMsg->flags = 0;
-	if(msg->isExtended()){
-		aMsg->flags |= CAN_FLAG_IS_EXTENDED;
-	}
+	jcConvertCanMessage(msg, aMsg);
 	return(true);
 }
 
@@ -195,22 +297,105 @@ int CAN_numSendAcknMessagesAvailable(int aHandle){
 }
 
 int CAN_getSendAcknMessage(int aHandle, CAN_CanMessage *aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
-	SharedCanMessage msg;
+	CanMessage msg;
 	if(!Manager->adapter(aHandle)->getSendAcknMessage(msg, aTransactionId, aTimeoutMs)){
 		return(false);
 	}
-	aMsg->id = msg->getId();
-	aMsg->len = msg->getLen();
-	for(int i=0; i<msg->getLen(); i++){
-		aMsg->data[i] = msg->getData(i);
+	jcConvertCanMessage(msg, aMsg);
+	return(true);
+}
+
+int CAN_sendMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint16_t *aTransactionId){
+	CanMessage msg;
+	if((aMsg->version != CAN_MESSAGE_FD_VERSION) || !jcConvertCanMessage(aMsg, msg)){
+		return(false);
 	}
-	aMsg->flags = 0;
-	if(msg->isExtended()){
-		aMsg->flags |= CAN_FLAG_IS_EXTENDED;
+	return Manager->adapter(aHandle)->sendMessage(msg, aTransactionId);
+}
+
+int CAN_getReceivedMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint32_t aTimeoutMs){
+	if(aMsg->version != CAN_MESSAGE_FD_VERSION){
+		return(false);
+	}
+	CanMessage msg;
+	if(!Manager->adapter(aHandle)->getReceivedMessage(msg, aTimeoutMs)){
+		return(false);
 	}
+	jcConvertCanMessage(msg, aMsg);
 	return(true);
 }
 
+int CAN_getSendAcknMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
+	if(aMsg->version != CAN_MESSAGE_FD_VERSION){
+		return(false);
+	}
+	CanMessage msg;
+	if(!Manager->adapter(aHandle)->getSendAcknMessage(msg, aTransactionId, aTimeoutMs)){
+		return(false);
+	}
+	jcConvertCanMessage(msg, aMsg);
+	return(true);
+}
+
+int CAN_sendMessages(int aHandle, CAN_CanMessage *aMsgs, int aNumMsgs, uint16_t *aFirstTransactionId){
+	return jcSendMessages(aHandle, aMsgs, aNumMsgs, aFirstTransactionId);
+}
+
+int CAN_getReceivedMessages(int aHandle, CAN_CanMessage *aMsgs, int aMaxMsgs, uint32_t aTimeoutMs){
+	return jcGetReceivedMessages(aHandle, aMsgs, aMaxMsgs, aTimeoutMs);
+}
+
+int CAN_sendMessagesFD(int aHandle, CAN_CanMessageFD *aMsgs, int aNumMsgs, uint16_t *aFirstTransactionId){
+	if((aNumMsgs > 0) && (aMsgs[0].version != CAN_MESSAGE_FD_VERSION)){
+		return(0);
+	}
+	return jcSendMessages(aHandle, aMsgs, aNumMsgs, aFirstTransactionId);
+}
+
+int CAN_getReceivedMessagesFD(int aHandle, CAN_CanMessageFD *aMsgs, int aMaxMsgs, uint32_t aTimeoutMs){
+	if((aMaxMsgs > 0) && (aMsgs[0].version != CAN_MESSAGE_FD_VERSION)){
+		return(0);
+	}
+	int n = jcGetReceivedMessages(aHandle, aMsgs, aMaxMsgs, aTimeoutMs);
+	for(int i=0; i<n; i++){
+		aMsgs[i].version = CAN_MESSAGE_FD_VERSION;
+	}
+	return(n);
+}
+
+int CAN_getReceivedMessageMatching(int aHandle, CAN_CanMessage *aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+	CanMessage msg;
+	if(!Manager->adapter(aHandle)->getReceivedMessageMatching(msg, aIdCode, aIdMask, aTimeoutMs)){
+		return(false);
+	}
+	jcConvertCanMessage(msg, aMsg);
+	return(true);
+}
+
+int CAN_getReceivedMessageMatchingFD(int aHandle, CAN_CanMessageFD *aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+	if(aMsg->version != CAN_MESSAGE_FD_VERSION){
+		return(false);
+	}
+	CanMessage msg;
+	if(!Manager->adapter(aHandle)->getReceivedMessageMatching(msg, aIdCode, aIdMask, aTimeoutMs)){
+		return(false);
+	}
+	jcConvertCanMessage(msg, aMsg);
+	return(true);
+}
+
+int CAN_getReceiveEventFd(int aHandle){
+	return Manager->adapter(aHandle)->getReceiveEventFd();
+}
+
+int CAN_setReceiveCallback(int aHandle, CAN_ReceiveCallback aCallback, void *aUser){
+	CanAdapter::ReceiveCallback callback;
+	if(aCallback != NULL){
+		callback = boost::bind(jcReceiveCallback, aCallback, aUser, _1, _2);
+	}
+	return Manager->adapter(aHandle)->setReceiveCallback(callback);
+}
+
 void CAN_close(int aHandle){
 	Manager->adapter(aHandle)->close();
 }
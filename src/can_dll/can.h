@@ -35,10 +35,15 @@
 extern "C" {
 #endif
 
-#define CAN_DLL_VERSION 0x0040 // 0.4
+#define CAN_DLL_VERSION 0x0101 // 1.1
 
 #define CAN_FLAG_IS_EXTENDED 0x0001
 #define CAN_FLAG_IS_REMOTE_FRAME 0x0002
+#define CAN_FLAG_IS_FD 0x0004
+#define CAN_FLAG_BRS 0x0008 // bit rate switch (FD only)
+#define CAN_FLAG_ESI 0x0010 // error state indicator (FD only)
+
+#define CAN_MESSAGE_FD_VERSION 1
 
 typedef enum {
 	CAN_Echo = 0,
@@ -58,8 +63,22 @@ typedef struct  {
 	unsigned int len;
 	unsigned char data[8];
 	uint16_t flags;
+	uint64_t timestamp; // ns since Unix epoch (or adapter clock if hardware time-stamped)
 } CAN_CanMessage;
 
+// classic or FD message, version must be set to CAN_MESSAGE_FD_VERSION
+typedef struct  {
+	uint16_t version;
+	uint16_t flags;
+	uint32_t id;
+	unsigned int len;
+	uint64_t timestamp; // ns since Unix epoch (or adapter clock if hardware time-stamped)
+	unsigned char data[64];
+} CAN_CanMessageFD;
+
+// invoked from adapter's receive thread, messages are only valid during the call
+typedef void (*CAN_ReceiveCallback)(void *aUser, const CAN_CanMessageFD *aMsgs, int aNumMsgs);
+
 DLLEXPORT int CAN_getDllVersion();
 
 DLLEXPORT int CAN_getFirstChannelName(CAN_AdapterType aType, char* aString, int aStringLength);
@@ -71,6 +90,7 @@ DLLEXPORT void CAN_releaseHandle(int aHandle);
 DLLEXPORT void CAN_releaseAllHandles();
 
 DLLEXPORT int CAN_setParameter(int aHandle, const char* aKey, const char* aValue);
+DLLEXPORT int CAN_getParameter(int aHandle, const char* aKey, char* aValue, int aValueLength);
 DLLEXPORT int CAN_setBaudRate(int aHandle, uint32_t aBaudrate);
 DLLEXPORT int CAN_getNumberOfFilters(int aHandle);
 // convention for mask: 1 = relevant
@@ -83,6 +103,22 @@ DLLEXPORT int CAN_numReceivedMessagesAvailable(int aHandle);
 DLLEXPORT int CAN_getReceivedMessage(int aHandle, CAN_CanMessage *aMsg, uint32_t aTimeoutMs);
 DLLEXPORT int CAN_numSendAcknMessagesAvailable(int aHandle);
 DLLEXPORT int CAN_getSendAcknMessage(int aHandle, CAN_CanMessage *aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+DLLEXPORT int CAN_sendMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint16_t *aTransactionId);
+DLLEXPORT int CAN_getReceivedMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint32_t aTimeoutMs);
+DLLEXPORT int CAN_getSendAcknMessageFD(int aHandle, CAN_CanMessageFD *aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+// batch transfers, returning number of messages sent/received (timeout only applies to first message)
+// FD variants: version must be set in first element
+DLLEXPORT int CAN_sendMessages(int aHandle, CAN_CanMessage *aMsgs, int aNumMsgs, uint16_t *aFirstTransactionId);
+DLLEXPORT int CAN_getReceivedMessages(int aHandle, CAN_CanMessage *aMsgs, int aMaxMsgs, uint32_t aTimeoutMs);
+DLLEXPORT int CAN_sendMessagesFD(int aHandle, CAN_CanMessageFD *aMsgs, int aNumMsgs, uint16_t *aFirstTransactionId);
+DLLEXPORT int CAN_getReceivedMessagesFD(int aHandle, CAN_CanMessageFD *aMsgs, int aMaxMsgs, uint32_t aTimeoutMs);
+// first message with (id & aIdMask) == (aIdCode & aIdMask), others remain in receive buffer
+DLLEXPORT int CAN_getReceivedMessageMatching(int aHandle, CAN_CanMessage *aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs);
+DLLEXPORT int CAN_getReceivedMessageMatchingFD(int aHandle, CAN_CanMessageFD *aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs);
+// descriptor readable while receive buffer is not empty (owned by adapter, -1 if not supported)
+DLLEXPORT int CAN_getReceiveEventFd(int aHandle);
+// while closed only, see "rx_mode" parameter (NULL callback to unregister)
+DLLEXPORT int CAN_setReceiveCallback(int aHandle, CAN_ReceiveCallback aCallback, void *aUser);
 DLLEXPORT void CAN_close(int aHandle);
 
 DLLEXPORT int CAN_getState(int aHandle);
@@ -22,6 +22,7 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
+#include <vector>
 
 #include <boost/scoped_ptr.hpp>
 
@@ -154,6 +155,24 @@ static int l_set_parameter(lua_State *L){
 	return 1;
 }
 
+static int l_get_parameter(lua_State *L){
+	loadWrapper(L);
+
+	// first argument must be handle
+	int h = luaL_checkinteger(L, 1);
+
+	// second argument must be key
+	const char *k = luaL_checkstring(L, 2);
+
+	char value[256];
+	if(!Can->getParameter(h, k, &value[0], 256)){
+		lua_pushnil(L);
+	} else {
+		lua_pushstring(L, value);
+	}
+	return 1;
+}
+
 static int l_set_baudrate(lua_State *L){
 	loadWrapper(L);
 
@@ -280,52 +299,76 @@ static int l_num_send_ackn_messages_available(lua_State *L){
 	return 1;
 }
 
-static int l_send_message(lua_State *L){
-	loadWrapper(L);
-
-	// first argument must be handle
-	int h = luaL_checkinteger(L, 1);
-
-	// second argument must be parameter table
-	luaL_checktype(L, 2, LUA_TTABLE);
+// converts message table at stack index into CAN message
+static void toCanMessage(lua_State *L, int aIndex, CAN_CanMessage &aMsg){
+	luaL_checktype(L, aIndex, LUA_TTABLE);
 
 	lua_pushstring(L, "id");
-	lua_gettable(L, -2);
+	lua_gettable(L, aIndex);
 	uint32_t id = luaL_checkinteger(L, -1);
 	lua_pop(L, 1);
 
 	lua_pushstring(L, "data");
-	lua_gettable(L, -2);
+	lua_gettable(L, aIndex);
 	const char *dataC = luaL_checkstring(L, -1);
 	std::string data(dataC);
 	lua_pop(L, 1);
 
 	lua_pushstring(L, "isext");
-	lua_gettable(L, -2);
+	lua_gettable(L, aIndex);
 	uint16_t isExt = lua_toboolean(L, -1);
 	lua_pop(L, 1);
 
 	if((data.length() & 1) != 0){
-		return luaL_error(L, "Invalid record.");
+		luaL_error(L, "Invalid record.");
 	}
 
 	unsigned int len = data.length()/2;
 	if(len > 8){
-		return luaL_error(L, "Record too long.");
+		luaL_error(L, "Record too long.");
 	}
 
-	CAN_CanMessage m;
-	m.id = id;
-	m.len = len;
-	m.flags = 0;
+	aMsg.id = id;
+	aMsg.len = len;
+	aMsg.flags = 0;
 	if(isExt){
-		m.flags |= CAN_FLAG_IS_EXTENDED;
+		aMsg.flags |= CAN_FLAG_IS_EXTENDED;
 	}
 	for(int i=0; i<len; i++){
 		int b = (int)strtol(data.substr(i*2,2).c_str(), NULL, 16);
-		m.data[i] = b;
+		aMsg.data[i] = b;
+	}
+}
+
+// pushes message table onto stack
+static void pushCanMessage(lua_State *L, const CAN_CanMessage &aMsg){
+	std::ostringstream oss;
+	for(int i=0; i<aMsg.len; i++){
+		oss <<  std::hex << std::setw(2) << std::setfill('0') << ((unsigned int)aMsg.data[i]);
 	}
 
+	lua_newtable(L);
+	lua_pushstring(L, "id");
+	lua_pushnumber(L, aMsg.id);
+	lua_settable(L, -3);
+	lua_pushstring(L, "isext");
+	lua_pushboolean(L, ((aMsg.flags & CAN_FLAG_IS_EXTENDED) != 0));
+	lua_settable(L, -3);
+	lua_pushstring(L, "data");
+	lua_pushstring(L, oss.str().c_str());
+	lua_settable(L, -3);
+}
+
+static int l_send_message(lua_State *L){
+	loadWrapper(L);
+
+	// first argument must be handle
+	int h = luaL_checkinteger(L, 1);
+
+	// second argument must be message table
+	CAN_CanMessage m;
+	toCanMessage(L, 2, m);
+
 	uint16_t transactionId;
 	if(!Can->sendMessage(h, &m, &transactionId)){
 		lua_pushnil(L);
@@ -335,6 +378,34 @@ static int l_send_message(lua_State *L){
 	return 1;
 }
 
+static int l_send_messages(lua_State *L){
+	loadWrapper(L);
+
+	// first argument must be handle
+	int h = luaL_checkinteger(L, 1);
+
+	// second argument must be array of message tables
+	luaL_checktype(L, 2, LUA_TTABLE);
+	int n = luaL_len(L, 2);
+	std::vector<CAN_CanMessage> msgs(n);
+	for(int i=0; i<n; i++){
+		lua_rawgeti(L, 2, i+1);
+		toCanMessage(L, lua_gettop(L), msgs[i]);
+		lua_pop(L, 1);
+	}
+
+	// return transaction id of first message, and number of messages sent
+	uint16_t transactionId;
+	int sent = (n > 0) ? Can->sendMessages(h, &msgs[0], n, &transactionId) : 0;
+	if(sent <= 0){
+		lua_pushnil(L);
+	} else {
+		lua_pushnumber(L, transactionId);
+	}
+	lua_pushinteger(L, (sent > 0) ? sent : 0);
+	return 2;
+}
+
 static int l_get_send_ackn_message(lua_State *L){
 	loadWrapper(L);
 
@@ -351,22 +422,8 @@ static int l_get_send_ackn_message(lua_State *L){
 		return 1;
 	}
 
-	std::ostringstream oss;
-	for(int i=0; i<m.len; i++){
-		oss <<  std::hex << std::setw(2) << std::setfill('0') << ((unsigned int)m.data[i]);
-	}
-
 	// return message
-	lua_newtable(L);
-	lua_pushstring(L, "id");
-	lua_pushnumber(L, m.id);
-	lua_settable(L, -3);
-	lua_pushstring(L, "isext");
-	lua_pushboolean(L, ((m.flags & CAN_FLAG_IS_EXTENDED) != 0));
-	lua_settable(L, -3);
-	lua_pushstring(L, "data");
-	lua_pushstring(L, oss.str().c_str());
-	lua_settable(L, -3);
+	pushCanMessage(L, m);
 	return 1;
 }
 
@@ -384,22 +441,56 @@ static int l_get_received_message(lua_State *L){
 		return 1;
 	}
 
-	std::ostringstream oss;
-	for(int i=0; i<m.len; i++){
-		oss <<  std::hex << std::setw(2) << std::setfill('0') << ((unsigned int)m.data[i]);
+	// return message
+	pushCanMessage(L, m);
+	return 1;
+}
+
+static int l_get_received_message_matching(lua_State *L){
+	loadWrapper(L);
+
+	// first argument must be handle
+	int h = luaL_checkinteger(L, 1);
+	// id code and mask ("1" = relevant)
+	uint32_t code = luaL_checkinteger(L, 2);
+	uint32_t mask = luaL_checkinteger(L, 3);
+	// timeout
+	uint32_t timeout = luaL_checkinteger(L, 4);
+
+	CAN_CanMessage m;
+	if(!Can->getReceivedMessageMatching(h, &m, code, mask, timeout)){
+		lua_pushnil(L);
+		return 1;
 	}
 
 	// return message
-	lua_newtable(L);
-	lua_pushstring(L, "id");
-	lua_pushnumber(L, m.id);
-	lua_settable(L, -3);
-	lua_pushstring(L, "isext");
-	lua_pushboolean(L, ((m.flags & CAN_FLAG_IS_EXTENDED) != 0));
-	lua_settable(L, -3);
-	lua_pushstring(L, "data");
-	lua_pushstring(L, oss.str().c_str());
-	lua_settable(L, -3);
+	pushCanMessage(L, m);
+	return 1;
+}
+
+static int l_get_received_messages(lua_State *L){
+	loadWrapper(L);
+
+	// first argument must be handle
+	int h = luaL_checkinteger(L, 1);
+	// maximum number of messages
+	int max = luaL_checkinteger(L, 2);
+	// timeout (for first message)
+	uint32_t timeout = luaL_checkinteger(L, 3);
+
+	std::vector<CAN_CanMessage> msgs((max > 0) ? max : 1);
+	int n = (max > 0) ? Can->getReceivedMessages(h, &msgs[0], max, timeout) : 0;
+	if(n <= 0){
+		lua_pushnil(L);
+		return 1;
+	}
+
+	// return array of messages
+	lua_createtable(L, n, 0);
+	for(int i=0; i<n; i++){
+		pushCanMessage(L, msgs[i]);
+		lua_rawseti(L, -2, i+1);
+	}
 	return 1;
 }
 
@@ -412,6 +503,7 @@ static const struct luaL_Reg mylib[]={
 		{"release_handle", l_release_handle},
 		{"release_all_handles", l_release_all_handles},
 		{"set_parameter", l_set_parameter},
+		{"get_parameter", l_get_parameter},
 		{"set_baudrate", l_set_baudrate},
 		{"get_number_of_filters", l_get_number_of_filters},
 		{"set_acceptance_filter", l_set_acceptance_filter},
@@ -424,8 +516,11 @@ static const struct luaL_Reg mylib[]={
 		{"num_received_messages_available", l_num_received_messages_available},
 		{"num_send_ackn_messages_available", l_num_send_ackn_messages_available},
 		{"send_message", l_send_message},
+		{"send_messages", l_send_messages},
 		{"get_send_ackn_message", l_get_send_ackn_message},
 		{"get_received_message", l_get_received_message},
+		{"get_received_messages", l_get_received_messages},
+		{"get_received_message_matching", l_get_received_message_matching},
 		{NULL, NULL}
 };
 
@@ -48,6 +48,27 @@ if can.open(h) and can.go_bus_on(h) then
 				print(string.format("Received: 0x%x %s %s", m.id, m.data, tostring(m.isext)))
 			end
 		end
+
+		tid, n = can.send_messages(h, {
+			{id = 0x770, data = "023E00FFFFFFFFFF", isext = false},
+			{id = 0x770, data = "023E80FFFFFFFFFF", isext = false}})
+		if not (tid == nil) then
+			print("Sent " .. n .. " messages, first transaction id " .. tid)
+		end
+
+		msgs = can.get_received_messages(h, 16, 1000)
+		if not (msgs == nil) then
+			for _, m in ipairs(msgs) do
+				print(string.format("Received: 0x%x %s %s", m.id, m.data, tostring(m.isext)))
+			end
+		end
+
+		-- wait for response, leaving other messages in the receive buffer
+		can.send_message(h, {id = 0x770, data = "023E00FFFFFFFFFF", isext = false})
+		m = can.get_received_message_matching(h, 0x778, 0x7FF, 1000)
+		if not (m == nil) then
+			print(string.format("Response: 0x%x %s %s", m.id, m.data, tostring(m.isext)))
+		end
 	end)
 
 	if not ok then
@@ -168,6 +168,27 @@ void KvaserCanAdapter::getErrorDescription(int aErrorCode, std::string &aErrorSt
 	}
 }
 
+/* Interface implementation */
+bool KvaserCanAdapter::setParameter(std::string aKey, std::string aValue){
+	if(aKey == "rx_mode"){
+		// received frames are buffered, passed to receive callback, or both
+		if(mIsOpen){
+			return(false);
+		}
+		return(mRxDispatcher.setMode(aValue));
+	}
+	return(false);
+}
+
+/* Interface implementation */
+bool KvaserCanAdapter::getParameter(std::string aKey, std::string &aValue){
+	if(aKey == "rx_mode"){
+		aValue = mRxDispatcher.getMode();
+		return(true);
+	}
+	return(false);
+}
+
 /* Interface implementation */
 bool KvaserCanAdapter::setBaudRate(uint32_t aBaudrate){
 	if(mIsOpen){
@@ -415,8 +436,8 @@ bool KvaserCanAdapter::goBusOff(){
 }
 
 /* Interface implementation */
-bool KvaserCanAdapter::sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId){
-	if(!mIsBusOn){
+bool KvaserCanAdapter::sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId){
+	if(!mIsBusOn || aMsg.isFd()){
 		return(false);
 	}
 
@@ -425,18 +446,48 @@ bool KvaserCanAdapter::sendMessage(SharedCanMessage aMsg, uint16_t *aTransaction
 		*aTransactionId = 0;
 	}
 	char msg[8];
-	for(int i=0; i<aMsg->getLen(); i++){
-		msg[i] = aMsg->getData(i);
+	for(int i=0; i<aMsg.getLen(); i++){
+		msg[i] = aMsg.getData(i);
 	}
 	boost::mutex::scoped_lock lock(mHandleMutex);
-	if(aMsg->isExtended()){
-		mLastKvaserStatusCode = canWrite(mPortHandle, aMsg->getId(), msg, aMsg->getLen(), canMSG_EXT);
+	if(aMsg.isExtended()){
+		mLastKvaserStatusCode = canWrite(mPortHandle, aMsg.getId(), msg, aMsg.getLen(), canMSG_EXT);
 	} else {
-		mLastKvaserStatusCode = canWrite(mPortHandle, aMsg->getId(), msg, aMsg->getLen(), 0);
+		mLastKvaserStatusCode = canWrite(mPortHandle, aMsg.getId(), msg, aMsg.getLen(), 0);
 	}
 	return (mLastKvaserStatusCode == canOK);
 }
 
+/* Interface implementation */
+int KvaserCanAdapter::sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId){
+	if(!mIsBusOn){
+		return(0);
+	}
+
+	// transaction ID not yet implemented
+	if(aFirstTransactionId != 0){
+		*aFirstTransactionId = 0;
+	}
+	char msg[8];
+	int n = 0;
+	boost::mutex::scoped_lock lock(mHandleMutex);
+	for(std::size_t i=0; i<aMsgs.size(); i++){
+		const CanMessage &m = aMsgs[i];
+		if(m.isFd()){
+			break;
+		}
+		for(int j=0; j<m.getLen(); j++){
+			msg[j] = m.getData(j);
+		}
+		mLastKvaserStatusCode = canWrite(mPortHandle, m.getId(), msg, m.getLen(), m.isExtended() ? canMSG_EXT : 0);
+		if(mLastKvaserStatusCode != canOK){
+			break;
+		}
+		n++;
+	}
+	return(n);
+}
+
 /* Interface implementation */
 int KvaserCanAdapter::numReceivedMessagesAvailable(){
 	if(!mIsBusOn){
@@ -446,13 +497,46 @@ int KvaserCanAdapter::numReceivedMessagesAvailable(){
 }
 
 /* Interface implementation */
-bool KvaserCanAdapter::getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs){
+bool KvaserCanAdapter::getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs){
 	if(!mIsOpen){
 		return(false);
 	}
 	return(mRxBuf.pop(aMsg, aTimeoutMs));
 }
 
+/* Interface implementation */
+int KvaserCanAdapter::getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs){
+	if(!mIsOpen || (aMaxMsgs == 0)){
+		aMsgs.clear();
+		return(0);
+	}
+	aMsgs.clear();
+	mRxBuf.popMany(aMsgs, aMaxMsgs, aTimeoutMs);
+	return((int)aMsgs.size());
+}
+
+/* Interface implementation */
+bool KvaserCanAdapter::getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+	if(!mIsOpen){
+		return(false);
+	}
+	return(mRxDispatcher.getMatching(mRxBuf, aMsg, aIdCode, aIdMask, aTimeoutMs));
+}
+
+/* Interface implementation */
+int KvaserCanAdapter::getReceiveEventFd(){
+	return(mRxBuf.getEventFd());
+}
+
+/* Interface implementation */
+bool KvaserCanAdapter::setReceiveCallback(ReceiveCallback aCallback){
+	if(mIsOpen){
+		return(false);
+	}
+	mRxDispatcher.setCallback(aCallback);
+	return(true);
+}
+
 /* Interface implementation */
 int KvaserCanAdapter::numSendAcknMessagesAvailable(){
 	if(!mIsBusOn){
@@ -462,13 +546,18 @@ int KvaserCanAdapter::numSendAcknMessagesAvailable(){
 }
 
 /* Interface implementation */
-bool KvaserCanAdapter::getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
+bool KvaserCanAdapter::getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
 	if(!mIsBusOn){
 		return(false);
 	}
 	return(mTxAckBuf.pop(aMsg, aTimeoutMs));
 }
 
+/* Interface implementation */
+int KvaserCanAdapter::getSendAcknEventFd(){
+	return(mTxAckBuf.getEventFd());
+}
+
 /* Interface implementation */
 enum CanAdapter::CanAdapterState KvaserCanAdapter::getState(){
 	if(!mIsOpen){
@@ -516,25 +605,46 @@ void KvaserCanAdapter::receive(){
 	unsigned int dlc;
 	unsigned int flag;
 	unsigned long time;
-	SharedCanMessage m;
+	CanMessage m;
+	// frames are handed over to the buffers in batches (one wakeup per burst)
+	CanMessage rx[RxBatchSize];
+	CanMessage txAck[RxBatchSize];
+	int numRx = 0;
+	int numTxAck = 0;
 
 	while(!mHaltReceiveThread){
 		boost::mutex::scoped_lock lock(mHandleMutex);
 		while( canRead(mPortHandle, &id, msg, &dlc, &flag, &time) == canOK){
 			if(flag & canMSG_EXT){
-				m = CanMessage::getSharedInstance(id, dlc, true);
+				m = CanMessage(id, dlc, true);
 			} else {
-				m = CanMessage::getSharedInstance(id, dlc);
+				m = CanMessage(id, dlc);
 			}
 			for(int i=0; i<dlc; i++){
-				m->setData(i, msg[i]);
+				m.setData(i, msg[i]);
 			}
 			if(flag & canMSG_TXACK){
-				mTxAckBuf.push(m, 0);
+				txAck[numTxAck++] = m;
+				if(numTxAck == RxBatchSize){
+					mTxAckBuf.pushMany(txAck, numTxAck, 0);
+					numTxAck = 0;
+				}
 			} else {
-				mRxBuf.push(m, 0);
+				rx[numRx++] = m;
+				if(numRx == RxBatchSize){
+					mRxDispatcher.dispatch(mRxBuf, rx, numRx);
+					numRx = 0;
+				}
 			}
 		}
+		if(numRx > 0){
+			mRxDispatcher.dispatch(mRxBuf, rx, numRx);
+			numRx = 0;
+		}
+		if(numTxAck > 0){
+			mTxAckBuf.pushMany(txAck, numTxAck, 0);
+			numTxAck = 0;
+		}
 		mCanEvent.wait(lock);
 	}
 }
@@ -18,36 +18,82 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include <boost/thread/thread.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/atomic.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <deque>
 
 #include "../utils/Logger.h"
 #include "../utils/LogFile.h"
 #include "../utils/SerialPortEnumerator.h"
 #include "../utils/AsyncSerial.h"
 #include "../utils/BlockingBufferWithTimeout.hpp"
+#include "../can/CanAcknBuffer.h"
+#include "../can/CanReceiveDispatcher.h"
 
 #include "SLCanAdapter.h"
 
+namespace {
+
+// value of hex digit, -1 if not a hex digit
+struct HexTable {
+	int8_t mValue[256];
+	HexTable(){
+		for(int i=0; i<256; i++){
+			mValue[i] = -1;
+		}
+		for(int i=0; i<10; i++){
+			mValue['0' + i] = i;
+		}
+		for(int i=0; i<6; i++){
+			mValue['a' + i] = 10 + i;
+			mValue['A' + i] = 10 + i;
+		}
+	}
+};
+const HexTable hexTable;
+
+}
+
 class SLCanAdapter_p {
-	static const int POLL_TIMEOUT_MS = 10;
 	static const int DEFAULT_LINE_RX_TIMEOUT_MS = 3000;
 	static const int CMD_TX_TIMEOUT_MS = 5000;
 	static const int StatusUpdateSpacingMs = 2000;
 	static const int OpenPortTimeourtMs = 500;
+	enum {MaxResponseLength = 64};
+	enum {RxBatchSize = 64};
+	enum {TimeStampWrapMs = 60000}; // adapter time-stamps count 0..59999 ms
+	enum {TimeStampDriftShift = 10}; // rate at which offset estimate follows clock drift
+
+	// receive parser states
+	enum RxState {
+		RxLineStart,
+		RxId,
+		RxDlc,
+		RxData,
+		RxTimeStamp,
+		RxComplete,
+		RxResponse,
+		RxDiscard
+	};
 
 public:
 	SLCanAdapter_p(std::string aChannelName, uint32_t aBaudrate):
 			mChannelName(aChannelName), mBaudrate(aBaudrate), mAc01(0), mAc23(0), mAm01(0), mAm23(0),
 			mSerialBaudrate(115200),
-			mThread(), mRxBuf(), mTxBuf(), mTxAckBuf(), mIsOpen(false),
+			mRxBuf(), mTxBuf(), mTxAckBuf(), mIsOpen(false),
 			mLogFile(), mMutex(), mCmdMutex(), mReponseStatus(""), mNotifier(), mRxTimeout(DEFAULT_LINE_RX_TIMEOUT_MS),
-			mLastStatusUpdateTime(boost::posix_time::neg_infin), mAdapterState(CanAdapter::Unknown)
+			mTimeStamps(false),
+			mLastStatusUpdateTime(boost::posix_time::neg_infin), mAdapterState(CanAdapter::Unknown),
+			mTxWindow(0), mTxPending(), mTxAbandoned(0), mTxWindowNotifier()
 	{
-		;
+		mTxErrors = 0;
 	}
 
 	~SLCanAdapter_p(){
@@ -60,6 +106,7 @@ public:
 	static bool getNextChannelName(std::string &aName);
 
 	bool setParameter(std::string aKey, std::string aValue);
+	bool getParameter(std::string aKey, std::string &aValue);
 	bool setBaudRate(uint32_t aBaudrate);
 	int getNumberOfFilters();
 	bool setAcceptanceFilter(int fid, uint32_t code, uint32_t mask, bool isExt);
@@ -67,20 +114,34 @@ public:
 	void close();
 	bool goBusOn();
 	bool goBusOff();
-	bool sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId);
+	bool sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId);
+	int sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId);
 	int numReceivedMessagesAvailable();
-	bool getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs);
+	bool getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs);
+	int getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs);
+	bool getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs);
+	int getReceiveEventFd();
+	bool setReceiveCallback(CanAdapter::ReceiveCallback aCallback);
 	int numSendAcknMessagesAvailable();
-	bool getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+	bool getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+	int getSendAcknEventFd();
 	enum CanAdapter::CanAdapterState getState();
 
 private:
 	bool sendCommand(std::string aCommand, std::string &aReponse);
+	std::size_t sendFrames(const CanMessage *aMsgs, std::size_t aCount, uint16_t aFirstTransactionId);
+	bool txWindowIsOpen();
+	bool txPipelineIsEmpty();
+	void txAcknowledged(bool aSuccess);
 	bool getSetBaudrateCmd(uint32_t aBaudrate, std::string &aBaudrateCmd);
 	void getSetFilterCmds(uint16_t aAc01, uint16_t aAc23, uint16_t aAm01, uint16_t aAm23, std::string &aCodeCmd, std::string &aMaskCmd);
-	void encode(SharedCanMessage aMsg, std::string &aTxCmd);
-	bool decode(std::string aRxCmd, SharedCanMessage &aMsg);
-	void receive();
+	void encode(const CanMessage &aMsg, std::string &aTxCmd);
+	void resetParser();
+	void parse(char aChar);
+	void endOfLine();
+	void flushRxFrames();
+	uint64_t getHostTimeStampNs(uint16_t aAdapterTimeMs);
+	void responseReceived(const std::string &aResponse);
 	void resetResponseStatus();
 	bool responseStatusIsKnown();
 	bool responseStatusIsOk();
@@ -96,21 +157,41 @@ private:
 
 	static std::vector<std::string> mDetectedPorts;
 	boost::scoped_ptr<CallbackAsyncSerial> mAsyncSerial;
-	BlockingBufferWithTimeout<char> mSerialRxBuf;
 
 	uint32_t mSerialBaudrate;
 
-	boost::thread mThread;
-
 	boost::atomic_bool mIsOpen;
-	CanMessageBuffer mRxBuf;
+	CanMessageRingBuffer mRxBuf;
+	CanReceiveDispatcher mRxDispatcher;
 	CanMessageBuffer mTxBuf;
-	CanMessageBuffer mTxAckBuf;
+	CanAcknBuffer mTxAckBuf;
 
-	std::vector<unsigned char> mInBuf;
-	int mRxTimer;
 	int mRxTimeout;
 
+	// receive parser, only used in serial callback
+	RxState mRxState;
+	bool mRxIsExt;
+	uint32_t mRxId;
+	unsigned int mRxDigits; // hex digits remaining in current field
+	unsigned int mRxLen;
+	unsigned int mRxDataIndex;
+	uint8_t mRxData[CanMessage::MaxClassicLen];
+	char mRxResponse[MaxResponseLength];
+	std::size_t mRxResponseLen;
+	uint64_t mRxLastByteNs;
+	uint64_t mRxTimeStampNs;
+
+	// adapter time-stamps (Z1), extended to 64 bit and aligned with host clock
+	bool mTimeStamps;
+	uint16_t mRxAdapterTime;
+	bool mAdapterTimeValid;
+	uint16_t mLastAdapterTimeMs;
+	uint64_t mAdapterTimeMs;
+	uint64_t mLastAdapterHostNs;
+	int64_t mAdapterTimeOffsetNs; // host time minus adapter time (lower envelope)
+	CanMessage mRxFrames[RxBatchSize];
+	std::size_t mNumRxFrames;
+
 	std::string mReponseStatus;
 	mutable boost::mutex mMutex;
 	mutable boost::mutex mCmdMutex;
@@ -119,10 +200,16 @@ private:
 	boost::posix_time::ptime mLastStatusUpdateTime;
 	CanAdapter::CanAdapterState mAdapterState;
 
+	// pipelined transmit: frames sent, awaiting z/Z acknowledgment in FIFO order (guarded by mMutex)
+	std::size_t mTxWindow; // max. frames in flight (0: wait for each acknowledgment)
+	std::deque<CanMessage> mTxPending;
+	std::size_t mTxAbandoned; // frames given up on after a timeout, their late acknowledgments are discarded
+	boost::condition_variable mTxWindowNotifier;
+	boost::atomic<uint32_t> mTxErrors;
+
 	LogFile mLogFile;
 };
 
-const int SLCanAdapter_p::POLL_TIMEOUT_MS;
 const int SLCanAdapter_p::CMD_TX_TIMEOUT_MS;
 const int SLCanAdapter_p::DEFAULT_LINE_RX_TIMEOUT_MS;
 
@@ -148,6 +235,10 @@ bool SLCanAdapter::setParameter(std::string aKey, std::string aValue){
 	return pimpl->setParameter(aKey, aValue);
 }
 
+bool SLCanAdapter::getParameter(std::string aKey, std::string &aValue){
+	return pimpl->getParameter(aKey, aValue);
+}
+
 bool SLCanAdapter::setBaudRate(uint32_t aBaudrate){
 	return pimpl->setBaudRate(aBaudrate);
 }
@@ -172,26 +263,50 @@ bool SLCanAdapter::goBusOff(){
 	return pimpl->goBusOff();
 }
 
-bool SLCanAdapter::sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId){
+bool SLCanAdapter::sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId){
 	return pimpl->sendMessage(aMsg, aTransactionId);
 }
 
+int SLCanAdapter::sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId){
+	return pimpl->sendMessages(aMsgs, aFirstTransactionId);
+}
+
 int SLCanAdapter::numReceivedMessagesAvailable(){
 	return pimpl->numReceivedMessagesAvailable();
 }
 
-bool SLCanAdapter::getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs){
+bool SLCanAdapter::getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs){
 	return pimpl->getReceivedMessage(aMsg, aTimeoutMs);
 }
 
+int SLCanAdapter::getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs){
+	return pimpl->getReceivedMessages(aMsgs, aMaxMsgs, aTimeoutMs);
+}
+
+bool SLCanAdapter::getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+	return pimpl->getReceivedMessageMatching(aMsg, aIdCode, aIdMask, aTimeoutMs);
+}
+
+int SLCanAdapter::getReceiveEventFd(){
+	return pimpl->getReceiveEventFd();
+}
+
+bool SLCanAdapter::setReceiveCallback(ReceiveCallback aCallback){
+	return pimpl->setReceiveCallback(aCallback);
+}
+
 int SLCanAdapter::numSendAcknMessagesAvailable(){
 	return pimpl->numSendAcknMessagesAvailable();
 }
 
-bool SLCanAdapter::getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
+bool SLCanAdapter::getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
 	return pimpl->getSendAcknMessage(aMsg, aTransactionId, aTimeoutMs);
 }
 
+int SLCanAdapter::getSendAcknEventFd(){
+	return pimpl->getSendAcknEventFd();
+}
+
 enum CanAdapter::CanAdapterState SLCanAdapter::getState(){
 	return pimpl->getState();
 }
@@ -238,12 +353,53 @@ bool SLCanAdapter_p::setParameter(std::string aKey, std::string aValue){
 				mSerialBaudrate = mNewSerialBaudrate;
 				return true;
 			}
+		} else if(aKey == "timestamps"){
+			// use time-stamps of adapter (Z1) rather than time of reception by host
+			if(!mIsOpen){
+				mTimeStamps = (aValue == "true");
+				return true;
+			}
+		} else if(aKey == "tx_window"){
+			// number of transmit commands sent ahead of acknowledgments (0: one at a time)
+			int newTxWindow = boost::lexical_cast<int>(aValue);
+			if(!mIsOpen && (newTxWindow >= 0)){
+				mTxWindow = newTxWindow;
+				return true;
+			}
+		} else if(aKey == "rx_mode"){
+			// buffered, callback or both
+			if(!mIsOpen){
+				return mRxDispatcher.setMode(aValue);
+			}
 		}
 	} catch (boost::bad_lexical_cast){
 	}
 	return false;
 }
 
+bool SLCanAdapter_p::getParameter(std::string aKey, std::string &aValue){
+	if(aKey == "rx_timeout_ms"){
+		aValue = boost::lexical_cast<std::string>(mRxTimeout);
+		return true;
+	} else if(aKey == "serial_baudrate"){
+		aValue = boost::lexical_cast<std::string>(mSerialBaudrate);
+		return true;
+	} else if(aKey == "timestamps"){
+		aValue = mTimeStamps ? "true" : "false";
+		return true;
+	} else if(aKey == "tx_window"){
+		aValue = boost::lexical_cast<std::string>(mTxWindow);
+		return true;
+	} else if(aKey == "tx_errors"){
+		aValue = boost::lexical_cast<std::string>(mTxErrors);
+		return true;
+	} else if(aKey == "rx_mode"){
+		aValue = mRxDispatcher.getMode();
+		return true;
+	}
+	return false;
+}
+
 void SLCanAdapter_p::close(){
 	if(mIsOpen){
 		// close adapter
@@ -251,7 +407,6 @@ void SLCanAdapter_p::close(){
 		sendCommand("C", rsp);
 
 		mIsOpen = false;
-		mThread.join();
 
 		mAsyncSerial->clearCallback();
 		mAsyncSerial.reset();
@@ -259,6 +414,11 @@ void SLCanAdapter_p::close(){
 		mTxBuf.clear();
 		mRxBuf.clear();
 		mTxAckBuf.clear();
+		{
+			boost::mutex::scoped_lock lock(mMutex);
+			mTxPending.clear();
+			mTxAbandoned = 0;
+		}
 
 		mLogFile.debugStream() << "closed" << std::endl;
 		mLogFile.close();
@@ -338,14 +498,12 @@ bool SLCanAdapter_p::open(){
 			}
 		}
 	}
+	resetParser();
 	mAsyncSerial->setCallback(boost::bind(&SLCanAdapter_p::rxCallback,this,_1,_2));
 
 	mLogFile.open();
 
-	// start receive thread
 	mIsOpen = true;
-	boost::thread t(boost::bind(&SLCanAdapter_p::receive, this));
-	mThread.swap(t);
 
 	std::string rsp;
 
@@ -403,6 +561,13 @@ bool SLCanAdapter_p::open(){
 		}
 	}
 
+	if(success && mTimeStamps){
+		// enable time-stamps
+		if(!sendCommand("Z1", rsp)){
+			success = false;
+		}
+	}
+
 	// open adapter
 	if(success){
 		if(!sendCommand("O", rsp)){
@@ -431,26 +596,48 @@ bool SLCanAdapter_p::goBusOff(){
 	return true;
 }
 
-bool SLCanAdapter_p::sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId){
-	if(!mIsOpen){
+bool SLCanAdapter_p::sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId){
+	if(!mIsOpen || aMsg.isFd()){
+		// CAN FD not supported by protocol
 		return false;
 	}
 
-	std::string req, rsp;
-	encode(aMsg, req);
-	if(!sendCommand(req, rsp)){
+	uint16_t transactionId = mTxAckBuf.allocateTransactionIds(1);
+	if(sendFrames(&aMsg, 1, transactionId) != 1){
 		return false;
 	}
 
-	// transaction ID not yet implemented
 	if(aTransactionId != 0){
-		*aTransactionId = 0;
+		*aTransactionId = transactionId;
 	}
-	// acknowledge transmit
-	mTxAckBuf.push(CanMessage::getSharedInstance(aMsg), 0);
 	return true;
 }
 
+int SLCanAdapter_p::sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId){
+	if(!mIsOpen || aMsgs.empty()){
+		return 0;
+	}
+
+	std::size_t numValid = 0;
+	while((numValid < aMsgs.size()) && !aMsgs[numValid].isFd()){
+		numValid++;
+	}
+	if(numValid == 0){
+		return 0;
+	}
+
+	uint16_t firstTransactionId = mTxAckBuf.allocateTransactionIds(numValid);
+	std::size_t n = sendFrames(&aMsgs[0], numValid, firstTransactionId);
+	if(n == 0){
+		return 0;
+	}
+
+	if(aFirstTransactionId != 0){
+		*aFirstTransactionId = firstTransactionId;
+	}
+	return (int)n;
+}
+
 int SLCanAdapter_p::numReceivedMessagesAvailable(){
 	if(!mIsOpen){
 		return(0);
@@ -458,13 +645,43 @@ int SLCanAdapter_p::numReceivedMessagesAvailable(){
 	return(mRxBuf.available());
 }
 
-bool SLCanAdapter_p::getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs){
+bool SLCanAdapter_p::getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs){
 	if(!mIsOpen){
 		return false;
 	}
 	return(mRxBuf.pop(aMsg, aTimeoutMs));
 }
 
+int SLCanAdapter_p::getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs){
+	if(!mIsOpen || (aMaxMsgs == 0)){
+		aMsgs.clear();
+		return 0;
+	}
+	aMsgs.clear();
+	mRxBuf.popMany(aMsgs, aMaxMsgs, aTimeoutMs);
+	return (int)aMsgs.size();
+}
+
+bool SLCanAdapter_p::getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+	if(!mIsOpen){
+		return false;
+	}
+	return mRxDispatcher.getMatching(mRxBuf, aMsg, aIdCode, aIdMask, aTimeoutMs);
+}
+
+// descriptor outlives open/close, so that it can stay registered with epoll
+int SLCanAdapter_p::getReceiveEventFd(){
+	return mRxBuf.getEventFd();
+}
+
+bool SLCanAdapter_p::setReceiveCallback(CanAdapter::ReceiveCallback aCallback){
+	if(mIsOpen){
+		return false;
+	}
+	mRxDispatcher.setCallback(aCallback);
+	return true;
+}
+
 int SLCanAdapter_p::numSendAcknMessagesAvailable(){
 	if(!mIsOpen){
 		return(0);
@@ -472,11 +689,15 @@ int SLCanAdapter_p::numSendAcknMessagesAvailable(){
 	return(mTxAckBuf.available());
 }
 
-bool SLCanAdapter_p::getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
+bool SLCanAdapter_p::getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
 	if(!mIsOpen){
 		return false;
 	}
-	return(mTxAckBuf.pop(aMsg, aTimeoutMs));
+	return(mTxAckBuf.pop(aMsg, aTransactionId, aTimeoutMs));
+}
+
+int SLCanAdapter_p::getSendAcknEventFd(){
+	return mTxAckBuf.getEventFd();
 }
 
 enum CanAdapter::CanAdapterState SLCanAdapter_p::getState(){
@@ -572,49 +793,20 @@ void SLCanAdapter_p::getSetFilterCmds(uint16_t aAc01, uint16_t aAc23, uint16_t a
 	aMaskCmd = osm.str();
 }
 
-void SLCanAdapter_p::encode(SharedCanMessage aMsg, std::string &aTxCmd){
+void SLCanAdapter_p::encode(const CanMessage &aMsg, std::string &aTxCmd){
 	std::ostringstream oss;
-	if(aMsg->isExtended()){
-		oss << "T" << std::setfill('0') << std::hex << std::setw(8) << aMsg->getId();
+	if(aMsg.isExtended()){
+		oss << "T" << std::setfill('0') << std::hex << std::setw(8) << aMsg.getId();
 	} else {
-		oss << "t" << std::setfill('0') << std::hex << std::setw(3) << aMsg->getId();
+		oss << "t" << std::setfill('0') << std::hex << std::setw(3) << aMsg.getId();
 	}
-	oss << std::setw(1) << aMsg->getLen();
-	for(int i=0; i<aMsg->getLen(); i++){
-		oss << std::setw(2) << (int)aMsg->getData(i);
+	oss << std::setw(1) << aMsg.getLen();
+	for(int i=0; i<aMsg.getLen(); i++){
+		oss << std::setw(2) << (int)aMsg.getData(i);
 	}
 	aTxCmd = oss.str();
 }
 
-bool SLCanAdapter_p::decode(std::string aRxCmd, SharedCanMessage &aMsg){
-	SharedCanMessage m;
-	int dataStartIndex;
-	try {
-		if(boost::algorithm::starts_with(aRxCmd, "T")){
-			int id = (int)strtol(aRxCmd.substr(1,8).c_str(), NULL, 16);
-			int dlc = (int)strtol(aRxCmd.substr(9,1).c_str(), NULL, 16);
-			m = CanMessage::getSharedInstance(id, dlc, true);
-			dataStartIndex = 10;
-		} else if(boost::algorithm::starts_with(aRxCmd, "t")){
-			int id = (int)strtol(aRxCmd.substr(1,3).c_str(), NULL, 16);
-			int dlc = (int)strtol(aRxCmd.substr(4,1).c_str(), NULL, 16);
-			m = CanMessage::getSharedInstance(id, dlc);
-			dataStartIndex = 5;
-		} else {
-			return false;
-		}
-		for(int i=0; i<m->getLen(); i++){
-			int b = (int)strtol(aRxCmd.substr(dataStartIndex,2).c_str(), NULL, 16);
-			m->setData(i, b);
-			dataStartIndex += 2;
-		}
-	} catch(...) {
-		return false;
-	}
-	aMsg = m;
-	return true;
-}
-
 void SLCanAdapter_p::resetResponseStatus(){
 	mReponseStatus = "?";
 }
@@ -644,6 +836,16 @@ bool SLCanAdapter_p::sendCommand(std::string aCommand, std::string &aResponse){
 	std::vector<char> vCmd(aCommand.begin(), aCommand.end());
 
 	boost::mutex::scoped_lock lock(mMutex);
+
+	// responses can only be matched once all pipelined frames are acknowledged
+	if(!mTxWindowNotifier.timed_wait(lock, boost::posix_time::milliseconds(CMD_TX_TIMEOUT_MS),
+			boost::bind(&SLCanAdapter_p::txPipelineIsEmpty, this))){
+		mLogFile.debugStream() << "tx acknowledgment timeout";
+		mTxErrors += mTxPending.size();
+		mTxAbandoned += mTxPending.size();
+		mTxPending.clear();
+	}
+
 	resetResponseStatus();
 
 	mAsyncSerial->write(vCmd);
@@ -667,71 +869,286 @@ bool SLCanAdapter_p::sendCommand(std::string aCommand, std::string &aResponse){
 	return true;
 }
 
-void SLCanAdapter_p::receive(){
-	char inc;
-
-	bool eol = false;
-	bool err = false;
-	while(mIsOpen){
-		if(mSerialRxBuf.pop(inc, POLL_TIMEOUT_MS)){
-			mRxTimer = 0;
-			if(inc == '\r'){
-				eol = true;
-			} else if(inc == 0x07){
-				err = true;
-			} else {
-				mInBuf.push_back(inc);
-			}
-		} else {
-			// nothing received
-			if(mInBuf.size() > 0){
-				// we have data lingering...
-				mRxTimer += POLL_TIMEOUT_MS;
-				if(mRxTimer > mRxTimeout){
-					mLogFile.debugStream() << "Rx timeout";
-					mInBuf.clear();
-				}
-			} else {
-				mRxTimer = 0;
+// sends transmit commands, either one at a time (mTxWindow == 0), or pipelined
+// with up to mTxWindow commands awaiting acknowledgment
+std::size_t SLCanAdapter_p::sendFrames(const CanMessage *aMsgs, std::size_t aCount, uint16_t aFirstTransactionId){
+	std::size_t n = 0;
+	std::string req, rsp;
+	if(mTxWindow == 0){
+		// each frame has to be confirmed by the adapter before the next one can be sent
+		while(n < aCount){
+			encode(aMsgs[n], req);
+			if(!sendCommand(req, rsp)){
+				break;
 			}
+			CanMessage ack(aMsgs[n]);
+			ack.setTransactionId(CanAcknBuffer::getTransactionId(aFirstTransactionId, n));
+			ack.setTimeStampNs(CanMessage::getCurrentTimeStampNs());
+			mTxAckBuf.push(ack);
+			n++;
 		}
+		return n;
+	}
 
-		if(err){
-			{
-				boost::mutex::scoped_lock lock(mMutex);
-				mReponseStatus = "!";
-			}
-			mNotifier.notify_one();
-			mInBuf.clear();
-			eol = false;
-			err = false;
-		} else if(eol){
-			std::string strMsg(mInBuf.begin(), mInBuf.end());
-			if(boost::algorithm::starts_with(strMsg, "t") || boost::algorithm::starts_with(strMsg, "T")){
-				// message received
-				SharedCanMessage m;
-				if(decode(strMsg, m)){
-					mRxBuf.push(m, 0);
-				}
-			} else {
-				// command response
-				{
-					boost::mutex::scoped_lock lock(mMutex);
-					mReponseStatus = strMsg;
-				}
-				mNotifier.notify_one();
-			}
-			mInBuf.clear();
-			eol = false;
-			err = false;
+	boost::mutex::scoped_lock cmdLock(mCmdMutex);
+	while(n < aCount){
+		boost::mutex::scoped_lock lock(mMutex);
+		// only block when window is full
+		if(!mTxWindowNotifier.timed_wait(lock, boost::posix_time::milliseconds(CMD_TX_TIMEOUT_MS),
+				boost::bind(&SLCanAdapter_p::txWindowIsOpen, this))){
+			mLogFile.debugStream() << "tx acknowledgment timeout";
+			mTxErrors += mTxPending.size();
+			mTxAbandoned += mTxPending.size();
+			mTxPending.clear();
+			break;
+		}
+		// fill window, and write commands in one go
+		std::string cmds;
+		while((n < aCount) && (mTxPending.size() < mTxWindow)){
+			CanMessage msg(aMsgs[n]);
+			msg.setTransactionId(CanAcknBuffer::getTransactionId(aFirstTransactionId, n));
+			encode(msg, req);
+			cmds += req;
+			cmds += "\r";
+			mTxPending.push_back(msg);
+			n++;
 		}
+		mLogFile.debugStream() << "cmd: " << cmds;
+		std::vector<char> vCmds(cmds.begin(), cmds.end());
+		mAsyncSerial->write(vCmds);
 	}
+	return n;
 }
 
+bool SLCanAdapter_p::txWindowIsOpen(){
+	return (mTxPending.size() < mTxWindow);
+}
+
+bool SLCanAdapter_p::txPipelineIsEmpty(){
+	return mTxPending.empty();
+}
+
+// matches acknowledgment (z/Z or error) with oldest pipelined frame, must be called with mMutex held
+void SLCanAdapter_p::txAcknowledged(bool aSuccess){
+	CanMessage msg = mTxPending.front();
+	mTxPending.pop_front();
+	if(aSuccess){
+		msg.setTimeStampNs(CanMessage::getCurrentTimeStampNs());
+		mTxAckBuf.push(msg);
+	} else {
+		mTxErrors++;
+	}
+	mTxWindowNotifier.notify_all();
+}
+
+void SLCanAdapter_p::resetParser(){
+	mRxState = RxLineStart;
+	mRxResponseLen = 0;
+	mRxLastByteNs = 0;
+	mNumRxFrames = 0;
+	mAdapterTimeValid = false;
+}
+
+// parses chunk as delivered by serial port, frames are decoded on the fly
 void SLCanAdapter_p::rxCallback(const char *data, unsigned int len){
-	for(int i=0; i<len; i++){
-		if(!mSerialRxBuf.push(data[i], 0)){
-			break; // buffer overrun
+	mRxTimeStampNs = CanMessage::getCurrentTimeStampNs();
+	if((mRxState != RxLineStart) && ((mRxTimeStampNs - mRxLastByteNs) > (uint64_t)mRxTimeout*1000000)){
+		// data lingering from incomplete line
+		mLogFile.debugStream() << "Rx timeout";
+		mRxState = RxLineStart;
+	}
+	mRxLastByteNs = mRxTimeStampNs;
+
+	for(unsigned int i=0; i<len; i++){
+		parse(data[i]);
+		if(mNumRxFrames == RxBatchSize){
+			flushRxFrames();
+		}
+	}
+	flushRxFrames();
+}
+
+void SLCanAdapter_p::parse(char aChar){
+	if(aChar == '\r'){
+		endOfLine();
+		mRxState = RxLineStart;
+		return;
+	} else if(aChar == 0x07){
+		// error response
+		responseReceived("!");
+		mRxState = RxLineStart;
+		return;
+	}
+
+	int value = hexTable.mValue[(unsigned char)aChar];
+	switch(mRxState){
+	case RxLineStart:
+		if((aChar == 't') || (aChar == 'T')){
+			mRxIsExt = (aChar == 'T');
+			mRxId = 0;
+			mRxDigits = mRxIsExt ? 8 : 3;
+			mRxState = RxId;
+		} else {
+			mRxResponse[0] = aChar;
+			mRxResponseLen = 1;
+			mRxState = RxResponse;
+		}
+		break;
+
+	case RxId:
+		if(value < 0){
+			mRxState = RxDiscard;
+			break;
+		}
+		mRxId = (mRxId << 4) | value;
+		if(--mRxDigits == 0){
+			mRxState = RxDlc;
+		}
+		break;
+
+	case RxDlc:
+		if((value < 0) || (value > CanMessage::MaxClassicLen)){
+			mRxState = RxDiscard;
+			break;
+		}
+		mRxLen = value;
+		mRxDataIndex = 0;
+		mRxDigits = 2*mRxLen;
+		if(mRxLen > 0){
+			mRxState = RxData;
+		} else {
+			mRxDigits = 4;
+			mRxAdapterTime = 0;
+			mRxState = mTimeStamps ? RxTimeStamp : RxComplete;
+		}
+		break;
+
+	case RxData:
+		if(value < 0){
+			mRxState = RxDiscard;
+			break;
+		}
+		if((mRxDigits & 1) == 0){
+			mRxData[mRxDataIndex] = value << 4;
+		} else {
+			mRxData[mRxDataIndex++] |= value;
+		}
+		if(--mRxDigits == 0){
+			mRxDigits = 4;
+			mRxAdapterTime = 0;
+			mRxState = mTimeStamps ? RxTimeStamp : RxComplete;
+		}
+		break;
+
+	case RxTimeStamp:
+		if(value < 0){
+			mRxState = RxDiscard;
+			break;
+		}
+		mRxAdapterTime = (mRxAdapterTime << 4) | value;
+		if(--mRxDigits == 0){
+			mRxState = RxComplete;
+		}
+		break;
+
+	case RxComplete:
+		// unexpected trailing characters
+		mRxState = RxDiscard;
+		break;
+
+	case RxResponse:
+		if(mRxResponseLen < MaxResponseLength){
+			mRxResponse[mRxResponseLen++] = aChar;
+		}
+		break;
+
+	case RxDiscard:
+		break;
+	}
+}
+
+void SLCanAdapter_p::endOfLine(){
+	switch(mRxState){
+	case RxComplete:
+	{
+		// message received
+		CanMessage &m = mRxFrames[mNumRxFrames++];
+		m = CanMessage(mRxId, mRxLen, mRxIsExt,
+				mTimeStamps ? getHostTimeStampNs(mRxAdapterTime) : mRxTimeStampNs);
+		memcpy(m.getDataPtr(), mRxData, mRxLen);
+		break;
+	}
+
+	case RxLineStart:
+		// empty line, i.e. plain acknowledgment
+		responseReceived("");
+		break;
+
+	case RxResponse:
+		responseReceived(std::string(mRxResponse, mRxResponseLen));
+		break;
+
+	default:
+		mLogFile.debugStream() << "Invalid frame received";
+		break;
+	}
+}
+
+// converts adapter time-stamp into host time
+uint64_t SLCanAdapter_p::getHostTimeStampNs(uint16_t aAdapterTimeMs){
+	if(aAdapterTimeMs >= TimeStampWrapMs){
+		return mRxTimeStampNs; // invalid
+	}
+	if(!mAdapterTimeValid){
+		mAdapterTimeValid = true;
+		mAdapterTimeMs = aAdapterTimeMs;
+		mAdapterTimeOffsetNs = (int64_t)mRxTimeStampNs - (int64_t)mAdapterTimeMs*1000000;
+	} else {
+		// extend to 64 bit, resolving the number of wraps from the time elapsed on the host
+		int64_t deltaMs = (aAdapterTimeMs + TimeStampWrapMs - mLastAdapterTimeMs) % TimeStampWrapMs;
+		int64_t elapsedMs = (int64_t)(mRxTimeStampNs - mLastAdapterHostNs)/1000000;
+		if(elapsedMs > deltaMs + TimeStampWrapMs/2){
+			deltaMs += ((elapsedMs - deltaMs + TimeStampWrapMs/2) / TimeStampWrapMs) * TimeStampWrapMs;
+		}
+		mAdapterTimeMs += deltaMs;
+
+		// host time exceeds adapter time by the offset plus the (varying) transfer latency,
+		// the lowest observed difference is the best estimate of the offset; the
+		// estimate also creeps upwards to follow drift of the adapter clock
+		int64_t offsetNs = (int64_t)mRxTimeStampNs - (int64_t)mAdapterTimeMs*1000000;
+		if(offsetNs < mAdapterTimeOffsetNs){
+			mAdapterTimeOffsetNs = offsetNs;
+		} else {
+			mAdapterTimeOffsetNs += (offsetNs - mAdapterTimeOffsetNs) >> TimeStampDriftShift;
+		}
+	}
+	mLastAdapterTimeMs = aAdapterTimeMs;
+	mLastAdapterHostNs = mRxTimeStampNs;
+	return (uint64_t)((int64_t)mAdapterTimeMs*1000000 + mAdapterTimeOffsetNs);
+}
+
+void SLCanAdapter_p::flushRxFrames(){
+	if(mNumRxFrames > 0){
+		mRxDispatcher.dispatch(mRxBuf, mRxFrames, mNumRxFrames);
+		mNumRxFrames = 0;
+	}
+}
+
+// command response, or acknowledgment of pipelined frame
+void SLCanAdapter_p::responseReceived(const std::string &aResponse){
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+		bool isAckn = ((aResponse == "z") || (aResponse == "Z") || (aResponse == "!"));
+		if(isAckn && !mTxPending.empty()){
+			txAcknowledged(aResponse != "!");
+		} else if(isAckn && (mTxAbandoned > 0)){
+			// late acknowledgment of a frame given up on, not a response to the current command
+			mTxAbandoned--;
+			mLogFile.debugStream() << "late tx acknowledgment discarded";
+			return;
+		} else {
+			mReponseStatus = aResponse;
 		}
 	}
+	mNotifier.notify_one();
 }
@@ -0,0 +1,297 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2018 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+
+#include "SLCanEmulator.h"
+
+// don't bother sleeping for less
+static const uint64_t MinPacingSleepNs = 200000;
+
+SLCanEmulator::SLCanEmulator(uint32_t aSerialBaudrate) :
+	mSerialBaudrate(aSerialBaudrate), mMaster(-1), mSlave(-1), mRunning(false),
+	mRxLineFreeNs(0), mTxLineFreeNs(0), mChannelOpen(false), mTimeStamps(false), mStatusFlags(0),
+	mNackInterval(0), mDropInterval(0), mCorruptInterval(0), mNumTransmits(0), mNumInjected(0),
+	mNumFramesTransmitted(0), mNumCommands(0){
+}
+
+SLCanEmulator::~SLCanEmulator(){
+	stop();
+}
+
+bool SLCanEmulator::start(){
+	if(mRunning){
+		return false;
+	}
+	mMaster = posix_openpt(O_RDWR | O_NOCTTY);
+	if(mMaster < 0){
+		return false;
+	}
+	if((grantpt(mMaster) != 0) || (unlockpt(mMaster) != 0) || (ptsname(mMaster) == NULL)){
+		stop();
+		return false;
+	}
+	mDeviceName = ptsname(mMaster);
+
+	// keep slave open, so that master does not see a hang-up while adapter is closed,
+	// and disable echo before the adapter gets a chance to write
+	mSlave = ::open(mDeviceName.c_str(), O_RDWR | O_NOCTTY);
+	if(mSlave < 0){
+		stop();
+		return false;
+	}
+	struct termios tio;
+	if(tcgetattr(mSlave, &tio) == 0){
+		cfmakeraw(&tio);
+		tcsetattr(mSlave, TCSANOW, &tio);
+	}
+
+	mLine.clear();
+	mChannelOpen = false;
+	mTimeStamps = false;
+	mNumTransmits = 0;
+	mNumInjected = 0;
+	mRunning = true;
+	mThread = boost::thread(boost::bind(&SLCanEmulator::run, this));
+	return true;
+}
+
+void SLCanEmulator::stop(){
+	if(mRunning){
+		mRunning = false;
+		mThread.join();
+	}
+	if(mSlave >= 0){
+		::close(mSlave);
+		mSlave = -1;
+	}
+	if(mMaster >= 0){
+		::close(mMaster);
+		mMaster = -1;
+	}
+	mChannelOpen = false;
+}
+
+void SLCanEmulator::setErrorInjection(uint32_t aNackInterval, uint32_t aDropInterval, uint32_t aCorruptInterval){
+	mNackInterval = aNackInterval;
+	mDropInterval = aDropInterval;
+	mCorruptInterval = aCorruptInterval;
+}
+
+bool SLCanEmulator::inject(const CanMessage &aMsg){
+	if(!mChannelOpen){
+		return false;
+	}
+	char line[MaxLineLength];
+	int n;
+	if(aMsg.isExtended()){
+		n = snprintf(line, sizeof(line), "T%08X%d", aMsg.getId(), aMsg.getLen());
+	} else {
+		n = snprintf(line, sizeof(line), "t%03X%d", aMsg.getId(), aMsg.getLen());
+	}
+	for(unsigned int i=0; i<aMsg.getLen(); i++){
+		n += snprintf(&line[n], sizeof(line)-n, "%02X", aMsg.getData(i));
+	}
+	if(mTimeStamps){
+		uint32_t ms = (uint32_t)((CanMessage::getCurrentTimeStampNs() / 1000000) % 60000);
+		n += snprintf(&line[n], sizeof(line)-n, "%04X", ms);
+	}
+	std::string data(line, n);
+	data += "\r";
+
+	boost::mutex::scoped_lock lock(mWriteMutex);
+	mNumInjected++;
+	if((mCorruptInterval > 0) && ((mNumInjected % mCorruptInterval) == 0)){
+		// garble a data (or dlc) digit
+		data[data.size()-2] = 'x';
+	}
+	pace(data.size(), mTxLineFreeNs);
+	return (::write(mMaster, data.c_str(), data.size()) == (ssize_t)data.size());
+}
+
+void SLCanEmulator::run(){
+	char buf[256];
+	struct pollfd pfd;
+	pfd.fd = mMaster;
+	pfd.events = POLLIN;
+	while(mRunning){
+		int rc = poll(&pfd, 1, 50);
+		if(rc <= 0){
+			continue;
+		}
+		ssize_t len = ::read(mMaster, buf, sizeof(buf));
+		if(len <= 0){
+			if((len < 0) && (errno != EAGAIN) && (errno != EINTR) && (errno != EIO)){
+				break;
+			}
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+			continue;
+		}
+		// data only becomes available once it has been shifted out
+		pace(len, mRxLineFreeNs);
+		for(ssize_t i=0; i<len; i++){
+			if(buf[i] == '\r'){
+				lineReceived(mLine);
+				mLine.clear();
+			} else if(mLine.size() < MaxLineLength){
+				mLine += buf[i];
+			}
+		}
+	}
+}
+
+void SLCanEmulator::lineReceived(const std::string &aLine){
+	mNumCommands++;
+	if(aLine.empty()){
+		respond("\r");
+		return;
+	}
+	switch(aLine[0]){
+	case 'V':
+		respond("V1013\r");
+		break;
+
+	case 'N':
+		respond("NEMU1\r");
+		break;
+
+	case 'S':
+	case 's':
+		if(mChannelOpen){
+			respond("\a");
+		} else if((aLine[0] == 'S') && ((aLine.size() != 2) || (aLine[1] < '0') || (aLine[1] > '8'))){
+			respond("\a");
+		} else {
+			respond("\r");
+		}
+		break;
+
+	case 'M':
+	case 'm':
+		respond(((aLine.size() == 9) && !mChannelOpen) ? "\r" : "\a");
+		break;
+
+	case 'Z':
+		if(mChannelOpen || (aLine.size() != 2)){
+			respond("\a");
+		} else {
+			mTimeStamps = (aLine[1] == '1');
+			respond("\r");
+		}
+		break;
+
+	case 'O':
+		if(mChannelOpen){
+			respond("\a");
+		} else {
+			mChannelOpen = true;
+			respond("\r");
+		}
+		break;
+
+	case 'C':
+		if(!mChannelOpen){
+			respond("\a");
+		} else {
+			mChannelOpen = false;
+			respond("\r");
+		}
+		break;
+
+	case 'F':
+	{
+		if(!mChannelOpen){
+			respond("\a");
+		} else {
+			char rsp[8];
+			snprintf(rsp, sizeof(rsp), "F%02X\r", (unsigned int)mStatusFlags);
+			respond(rsp);
+		}
+		break;
+	}
+
+	case 't':
+	case 'T':
+		transmitReceived(aLine, (aLine[0] == 'T'));
+		break;
+
+	default:
+		respond("\a");
+		break;
+	}
+}
+
+void SLCanEmulator::transmitReceived(const std::string &aLine, bool aIsExt){
+	mNumTransmits++;
+	if((mDropInterval > 0) && ((mNumTransmits % mDropInterval) == 0)){
+		// lost on the serial line
+		return;
+	}
+	if((mNackInterval > 0) && ((mNumTransmits % mNackInterval) == 0)){
+		respond("\a");
+		return;
+	}
+	std::size_t idLen = aIsExt ? 8 : 3;
+	if(!mChannelOpen || (aLine.size() < idLen + 2)){
+		respond("\a");
+		return;
+	}
+	unsigned int len = aLine[idLen + 1] - '0';
+	if((len > 8) || (aLine.size() != idLen + 2 + 2*len)){
+		respond("\a");
+		return;
+	}
+	mNumFramesTransmitted++;
+	respond(aIsExt ? "Z\r" : "z\r");
+}
+
+void SLCanEmulator::respond(const std::string &aResponse){
+	boost::mutex::scoped_lock lock(mWriteMutex);
+	pace(aResponse.size(), mTxLineFreeNs);
+	if(::write(mMaster, aResponse.c_str(), aResponse.size()) != (ssize_t)aResponse.size()){
+		fprintf(stderr, "SLCanEmulator: write failed\n");
+	}
+}
+
+// blocks until the characters would have been transmitted at the configured baudrate
+void SLCanEmulator::pace(std::size_t aNumChars, uint64_t &aLineFreeNs){
+	if(mSerialBaudrate == 0){
+		return;
+	}
+	// 8N1: 10 bits per character
+	uint64_t now = CanMessage::getCurrentTimeStampNs();
+	if(aLineFreeNs < now){
+		aLineFreeNs = now;
+	}
+	aLineFreeNs += (uint64_t)aNumChars * 10 * 1000000000 / mSerialBaudrate;
+	if(aLineFreeNs > now + MinPacingSleepNs){
+		boost::this_thread::sleep_for(boost::chrono::nanoseconds(aLineFreeNs - now));
+	}
+}
@@ -0,0 +1,137 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2018 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SL_CAN_EMULATOR_H_
+#define SL_CAN_EMULATOR_H_
+
+#include <string>
+#include <stdint.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+
+#include "../../can/CanMessage.h"
+
+/**
+ * Emulates an SLCAN (Lawicel) device on a pseudo-terminal.
+ *
+ * The slave side of the pty is used as channel name of an SLCanAdapter.
+ * Transmission over the serial line is paced according to the configured
+ * serial baudrate, in both directions.
+ */
+class SLCanEmulator : private boost::noncopyable {
+
+public:
+	SLCanEmulator(uint32_t aSerialBaudrate = 115200);
+	virtual ~SLCanEmulator();
+
+	/**
+	 * Creates pty and starts emulation.
+	 * @return true if successful
+	 */
+	bool start();
+
+	/**
+	 * Stops emulation and releases pty.
+	 */
+	void stop();
+
+	/**
+	 * Name of device to be opened by adapter (e.g. /dev/pts/3).
+	 */
+	std::string getDeviceName() const { return mDeviceName; };
+
+	/**
+	 * Sets serial baudrate used for pacing, 0 for no pacing.
+	 */
+	void setSerialBaudrate(uint32_t aSerialBaudrate){ mSerialBaudrate = aSerialBaudrate; };
+
+	/**
+	 * Configures error injection, intervals of 0 disable the corresponding error.
+	 * @param aNackInterval every n-th transmit command is rejected
+	 * @param aDropInterval every n-th transmit command is not answered
+	 * @param aCorruptInterval every n-th injected frame is corrupted
+	 */
+	void setErrorInjection(uint32_t aNackInterval, uint32_t aDropInterval, uint32_t aCorruptInterval);
+
+	/**
+	 * Sets status flags returned by "F" command.
+	 */
+	void setStatusFlags(uint8_t aFlags){ mStatusFlags = aFlags; };
+
+	/**
+	 * Sends frame to adapter, as if received from the bus.
+	 * Blocks according to serial pacing.
+	 * @return false if channel is not open
+	 */
+	bool inject(const CanMessage &aMsg);
+
+	/**
+	 * Whether channel has been opened by "O" command.
+	 */
+	bool channelIsOpen() const { return mChannelOpen; };
+
+	/**
+	 * Statistics.
+	 */
+	uint32_t getNumFramesTransmitted() const { return mNumFramesTransmitted; };
+	uint32_t getNumCommands() const { return mNumCommands; };
+
+private:
+	enum {
+		MaxLineLength = 64
+	};
+
+	void run();
+	void lineReceived(const std::string &aLine);
+	void transmitReceived(const std::string &aLine, bool aIsExt);
+	void respond(const std::string &aResponse);
+	void pace(std::size_t aNumChars, uint64_t &aLineFreeNs);
+
+	uint32_t mSerialBaudrate;
+	int mMaster;
+	int mSlave;
+	std::string mDeviceName;
+
+	boost::thread mThread;
+	boost::atomic<bool> mRunning;
+	boost::mutex mWriteMutex;
+
+	uint64_t mRxLineFreeNs;
+	uint64_t mTxLineFreeNs;
+	std::string mLine;
+
+	boost::atomic<bool> mChannelOpen;
+	boost::atomic<bool> mTimeStamps;
+	boost::atomic<uint8_t> mStatusFlags;
+
+	boost::atomic<uint32_t> mNackInterval;
+	boost::atomic<uint32_t> mDropInterval;
+	boost::atomic<uint32_t> mCorruptInterval;
+	uint32_t mNumTransmits;
+	uint32_t mNumInjected;
+
+	boost::atomic<uint32_t> mNumFramesTransmitted;
+	boost::atomic<uint32_t> mNumCommands;
+};
+
+#endif /* SL_CAN_EMULATOR_H_ */
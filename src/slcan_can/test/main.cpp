@@ -0,0 +1,243 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2018 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * SLCAN throughput and latency benchmark.
+ *
+ * Runs an SLCanAdapter against an emulated SLCAN device on a pseudo-terminal
+ * and reports frames/s as well as p50/p99 latencies for:
+ *   - commands: frames sent one at a time, each awaiting the adapter's response
+ *   - send: pipelined frames, from sendMessage() until acknowledged
+ *   - receive: frames injected by the device until retrieved from the adapter,
+ *     or until passed to a receive callback
+ *
+ * Usage: TestSLCanBenchmark [frames] [serial_baudrate] [tx_window] [error_interval]
+ *
+ * Adapter traffic is logged to the file named by SLCAN_LOG (or std::cout), if set.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "../SLCanAdapter.h"
+#include "SLCanEmulator.h"
+
+static void report(const std::string &aName, std::vector<uint64_t> &aLatenciesNs, uint32_t aNumFrames, uint64_t aDurationNs){
+	std::cout << aName << ": " << aLatenciesNs.size() << "/" << aNumFrames << " frames, ";
+	if(aDurationNs > 0){
+		std::cout << (uint32_t)(aLatenciesNs.size() * 1.0e9 / aDurationNs) << " frames/s";
+	}
+	if(!aLatenciesNs.empty()){
+		std::sort(aLatenciesNs.begin(), aLatenciesNs.end());
+		std::cout << ", latency p50 " << aLatenciesNs[aLatenciesNs.size()/2]/1000 << " us"
+				<< ", p99 " << aLatenciesNs[(aLatenciesNs.size()*99)/100]/1000 << " us";
+	}
+	std::cout << std::endl;
+}
+
+static bool openAdapter(SLCanAdapter &aCan, uint32_t aSerialBaudrate, uint32_t aTxWindow){
+	return aCan.setParameter("log_file", getenv("SLCAN_LOG") ? getenv("SLCAN_LOG") : "")
+			&& aCan.setParameter("serial_baudrate", boost::lexical_cast<std::string>(aSerialBaudrate))
+			&& aCan.setParameter("tx_window", boost::lexical_cast<std::string>(aTxWindow))
+			&& aCan.open();
+}
+
+static void printErrors(SLCanAdapter &aCan){
+	std::string txErrors;
+	aCan.getParameter("tx_errors", txErrors);
+	std::cout << "  tx_errors: " << txErrors << std::endl;
+}
+
+static bool sendBenchmark(SLCanEmulator &aEmu, const std::string &aName, uint32_t aNumFrames, uint32_t aSerialBaudrate, uint32_t aTxWindow){
+	SLCanAdapter can(aEmu.getDeviceName(), 500000);
+	if(!openAdapter(can, aSerialBaudrate, aTxWindow)){
+		std::cout << "Unable to open adapter" << std::endl;
+		return false;
+	}
+
+	// time of submission, indexed by transaction id
+	std::vector<uint64_t> sentNs(0x10000);
+	std::vector<uint64_t> latencies;
+	CanMessage msg(0x123, 8);
+	CanMessage ack;
+	uint64_t start = CanMessage::getCurrentTimeStampNs();
+	uint64_t end = start;
+	uint32_t numSent = 0;
+	while(latencies.size() < numSent || numSent < aNumFrames){
+		if(numSent < aNumFrames){
+			uint16_t tid;
+			msg.setData(0, numSent & 0xFF);
+			uint64_t now = CanMessage::getCurrentTimeStampNs();
+			if(!can.sendMessage(msg, &tid)){
+				break;
+			}
+			sentNs[tid] = now;
+			numSent++;
+		}
+		// collect acknowledgments as they come, wait for stragglers at the end
+		uint32_t timeoutMs = (numSent < aNumFrames) ? 0 : 500;
+		bool acknowledged = false;
+		while(can.getSendAcknMessage(ack, 0, timeoutMs)){
+			latencies.push_back(ack.getTimeStampNs() - sentNs[ack.getTransactionId()]);
+			end = std::max(end, ack.getTimeStampNs());
+			acknowledged = true;
+			timeoutMs = 0;
+		}
+		if(!acknowledged && (numSent == aNumFrames)){
+			// remainder failed
+			break;
+		}
+	}
+	report(aName, latencies, aNumFrames, end - start);
+	printErrors(can);
+	can.close();
+	return true;
+}
+
+static void injectFrames(SLCanEmulator *aEmu, uint32_t aNumFrames){
+	CanMessage msg(0x321, 8);
+	for(uint32_t i=0; i<aNumFrames; i++){
+		// embed time of injection
+		uint64_t ns = CanMessage::getCurrentTimeStampNs();
+		for(int b=0; b<8; b++){
+			msg.setData(b, (uint8_t)(ns >> (8*b)));
+		}
+		if(!aEmu->inject(msg)){
+			break;
+		}
+	}
+}
+
+static uint64_t getInjectionTimeStampNs(const CanMessage &aMsg){
+	uint64_t ns = 0;
+	for(int b=0; b<8; b++){
+		ns |= (uint64_t)aMsg.getData(b) << (8*b);
+	}
+	return ns;
+}
+
+// collects latencies of frames delivered to receive callback
+class RxCallbackCollector {
+public:
+	void onReceive(const CanMessage *aMsgs, std::size_t aCount){
+		uint64_t now = CanMessage::getCurrentTimeStampNs();
+		boost::mutex::scoped_lock lock(mMutex);
+		for(std::size_t i=0; i<aCount; i++){
+			mLatencies.push_back(now - getInjectionTimeStampNs(aMsgs[i]));
+		}
+	}
+
+	std::vector<uint64_t> getLatencies(){
+		boost::mutex::scoped_lock lock(mMutex);
+		return mLatencies;
+	}
+
+private:
+	boost::mutex mMutex;
+	std::vector<uint64_t> mLatencies;
+};
+
+static bool receiveBenchmark(SLCanEmulator &aEmu, uint32_t aNumFrames, uint32_t aSerialBaudrate, bool aUseCallback){
+	SLCanAdapter can(aEmu.getDeviceName(), 500000);
+	RxCallbackCollector collector;
+	if(aUseCallback){
+		can.setParameter("rx_mode", "callback");
+		can.setReceiveCallback(boost::bind(&RxCallbackCollector::onReceive, &collector, _1, _2));
+	}
+	if(!openAdapter(can, aSerialBaudrate, 0)){
+		std::cout << "Unable to open adapter" << std::endl;
+		return false;
+	}
+
+	std::vector<uint64_t> latencies;
+	std::vector<CanMessage> msgs;
+	uint64_t start = CanMessage::getCurrentTimeStampNs();
+	boost::thread injector(boost::bind(injectFrames, &aEmu, aNumFrames));
+	if(aUseCallback){
+		injector.join();
+		// wait for frames still in transit
+		for(int i=0; (i<50) && (collector.getLatencies().size() < aNumFrames); i++){
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+		}
+		latencies = collector.getLatencies();
+	} else {
+		while(latencies.size() < aNumFrames){
+			if(can.getReceivedMessages(msgs, 256, 500) == 0){
+				// remainder lost
+				break;
+			}
+			uint64_t now = CanMessage::getCurrentTimeStampNs();
+			for(std::size_t i=0; i<msgs.size(); i++){
+				latencies.push_back(now - getInjectionTimeStampNs(msgs[i]));
+			}
+		}
+		injector.join();
+	}
+	uint64_t end = CanMessage::getCurrentTimeStampNs();
+
+	report(aUseCallback ? "receive (callback)" : "receive", latencies, aNumFrames, end - start);
+	can.close();
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t numFrames = (argc > 1) ? atoi(argv[1]) : 10000;
+	uint32_t serialBaudrate = (argc > 2) ? atoi(argv[2]) : 3000000;
+	uint32_t txWindow = (argc > 3) ? atoi(argv[3]) : 16;
+	uint32_t errorInterval = (argc > 4) ? atoi(argv[4]) : 0;
+
+	SLCanEmulator emu(serialBaudrate);
+	if(!emu.start()){
+		std::cout << "Unable to create pseudo-terminal" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Emulating SLCAN device on " << emu.getDeviceName()
+			<< " at " << serialBaudrate << " baud" << std::endl;
+
+	// error-free round trips
+	if(!sendBenchmark(emu, "commands", std::min(numFrames, (uint32_t)1000), serialBaudrate, 0)
+			|| !sendBenchmark(emu, "send", numFrames, serialBaudrate, txWindow)
+			|| !receiveBenchmark(emu, numFrames, serialBaudrate, false)
+			|| !receiveBenchmark(emu, numFrames, serialBaudrate, true)){
+		return EXIT_FAILURE;
+	}
+
+	if(errorInterval > 0){
+		// rejected transmissions and corrupted frames (dropped responses stall for the command timeout)
+		emu.setErrorInjection(errorInterval, 0, errorInterval);
+		std::cout << "Injecting errors every " << errorInterval << " frames" << std::endl;
+		if(!sendBenchmark(emu, "send", numFrames, serialBaudrate, txWindow)
+				|| !receiveBenchmark(emu, numFrames, serialBaudrate, false)
+			|| !receiveBenchmark(emu, numFrames, serialBaudrate, true)){
+			return EXIT_FAILURE;
+		}
+	}
+
+	emu.stop();
+	return EXIT_SUCCESS;
+}
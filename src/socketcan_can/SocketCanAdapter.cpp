@@ -22,35 +22,67 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <errno.h>
+
+#include <deque>
+#include <algorithm>
 
 #include <linux/can.h>
 #include <linux/can/raw.h>
+#include <linux/can/error.h>
+#include <linux/net_tstamp.h>
 
 #include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/format.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/atomic.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "../utils/Logger.h"
 #include "../utils/LogFile.h"
 
 #include <libsocketcan.h>
+#include "../can/CanAcknBuffer.h"
+#include "../can/CanReceiveDispatcher.h"
 #include "SocketCanAdapter.h"
+#include "SocketCanReactor.h"
+#include "SocketCanLinkMonitor.h"
+
+#ifndef CAN_RAW_FILTER_MAX
+#define CAN_RAW_FILTER_MAX 512 // as in later kernel headers
+#endif
+
+#ifndef CAN_ERR_CNT
+#define CAN_ERR_CNT 0x00000200U // as in later kernel headers
+#endif
 
 class SocketCanAdapter_p {
 	static const int POLL_TIMEOUT_MS = 10;
 	static const int DEFAULT_LINE_RX_TIMEOUT_MS = 3000;
 	static const int CMD_TX_TIMEOUT_MS = 5000;
-	enum {NumFilters = 1};
+	static const int TX_RETRY_DELAY_MS = 1;
+	enum {NumFilters = CAN_RAW_FILTER_MAX};
+	enum {MaxRxBatch = 256};
+	enum {MaxTxBatch = 64};
+	enum {MaxTxInFlight = 4096};
+	// room for SCM_TIMESTAMPING (software, deprecated, raw hardware)
+	enum {RxControlSize = CMSG_SPACE(3*sizeof(struct timespec))};
+	enum TimeStamping {TimeStampingOff, TimeStampingSoftware, TimeStampingHardware};
 
 public:
 	SocketCanAdapter_p(std::string aChannelName, uint32_t aBaudrate);
 	virtual ~SocketCanAdapter_p();
 
+	static bool getFirstChannelName(std::string &aName);
+	static bool getNextChannelName(std::string &aName);
+
 	bool setParameter(std::string aKey, std::string aValue);
+	bool getParameter(std::string aKey, std::string &aValue);
 	bool setBaudRate(uint32_t aBaudrate);
 	int getNumberOfFilters();
 	bool setAcceptanceFilter(int fid, uint32_t code, uint32_t mask, bool isExt);
@@ -60,45 +92,153 @@ public:
 	bool goBusOn();
 	bool goBusOff();
 
-	bool sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId);
+	enum CanAdapter::CanAdapterState getState();
+	void getErrorCounters(int *aTxErrorCounter, int *aRxErrorCounter);
+
+	bool sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId);
+	int sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId);
 
 	int numReceivedMessagesAvailable();
 	int numSendAcknMessagesAvailable();
-	bool getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
-	bool getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs);
+	bool getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+	int getSendAcknEventFd();
+	bool getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs);
+	int getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs);
+	bool getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs);
+	int getReceiveEventFd();
+	bool setReceiveCallback(CanAdapter::ReceiveCallback aCallback);
 
 private:
-	bool toCanFrame(SharedCanMessage &aMsg, struct can_frame &aFrame);
-	bool fromCanFrame(struct can_frame &aFrame, SharedCanMessage &aMsg);
+	std::size_t toCanFrame(const CanMessage &aMsg, struct canfd_frame &aFrame);
+	bool fromCanFrame(const struct canfd_frame &aFrame, std::size_t aMtu, uint64_t aTimeStampNs, CanMessage &aMsg);
+	bool isSupported(const CanMessage &aMsg);
+	bool enableTimeStamping();
+	bool applyFilters();
+	uint64_t getTimeStampNs(struct msghdr &aMsgHdr);
+
+	bool doOpen();
+	void shutdown();
+	void linkChanged(const std::string &aName, SocketCanLinkMonitor::LinkEvent aEvent);
+
+	typedef void (SocketCanAdapter_p::*Handler)();
+	bool postHandler(Handler aHandler);
+	void runHandler(Handler aHandler);
+	void handlerStarted();
+	void handlerFinished();
+
+	// marks completion of handler when leaving scope
+	class HandlerScope {
+	public:
+		HandlerScope(SocketCanAdapter_p &aAdapter) : mAdapter(aAdapter) {};
+		~HandlerScope(){ mAdapter.handlerFinished(); };
+	private:
+		SocketCanAdapter_p &mAdapter;
+	};
 
 	void doRead();
-	void readEnd(struct can_frame &aRxFrame, const boost::system::error_code& error, size_t bytes_transferred);
+	void readBatch(const boost::system::error_code& error);
 	void doWrite();
-	void writeEnd(struct can_frame &aTxFrame, const boost::system::error_code& error);
+	void sendPending();
+	void waitWritable(bool aNoBufs);
+	void writeReady(const boost::system::error_code& error);
 	void doClose();
-	bool write(SharedCanMessage aMsg);
+	void closeSocket();
+	bool write(const CanMessage &aMsg);
+	bool confirm(CanMessage &aMsg);
+	static bool isLoopBackOf(const CanMessage &aSent, const CanMessage &aLoopedBack);
+	void handleErrorFrame(const struct canfd_frame &aFrame);
+	void readLinkState();
+	void startStateRefresh();
+	void refreshState(const boost::system::error_code& error);
 
 	boost::atomic_bool mIsOpen;
-	CanMessageBuffer mRxBuf;
+	CanMessageRingBuffer mRxBuf;
+	CanReceiveDispatcher mRxDispatcher;
 	CanMessageBuffer mTxBuf;
-	CanMessageBuffer mTxAckBuf;
+	CanAcknBuffer mTxAckBuf;
 
 	std::string mChannelName;
 
+	static std::size_t mChannelIndex;
+	static std::vector<std::string> mDetectedChannels;
+
+	// re-opening when interface re-appears
+	boost::mutex mOpenMutex;
+	bool mAutoReopen;
+	boost::atomic_bool mWantOpen; // open() called, and not yet closed
+	SharedSocketCanLinkMonitor mLinkMonitor;
+	int mLinkListenerId;
+	SocketCanLinkMonitor::LinkEvent mLinkState;
+	boost::atomic<uint32_t> mReopenCount;
+
+	// acceptance filters, only the ones in use are handed to the kernel
+	boost::mutex mFilterMutex;
 	struct can_filter mFilter[NumFilters];
+	bool mFilterUsed[NumFilters];
+	bool mFilterInverted[NumFilters];
+	bool mJoinFilters;
 	uint32_t mBaudrate;
 	bool doIpConfig;
+	bool mFdEnabled;
+	bool mTxConfirm;
+	uint32_t mDataBitrate;
 
-	boost::thread mThread; // for ioservice thread
 	// only use in ioservice thread
 	bool mWriteIsIdle;
-	struct can_frame mRxFrame;
-	struct can_frame mTxFrame;
+
+	// batched transmit (sendmmsg), frames mTxPos..mTxCount-1 are pending
+	std::size_t mTxCount;
+	std::size_t mTxPos;
+	bool mTxRetrying;
+	struct canfd_frame mTxFrames[MaxTxBatch];
+	struct iovec mTxIovecs[MaxTxBatch];
+	struct mmsghdr mTxMsgHdrs[MaxTxBatch];
+	CanMessage mTxMsgs[MaxTxBatch];
+	// sent, but not yet confirmed by loop-back (in order of transmission)
+	std::deque<CanMessage> mTxInFlight;
+
+	// receive (recvmmsg), up to mRxBatch frames per system call
+	std::size_t mRxBatch;
+	enum TimeStamping mTimeStamping;
+	std::vector<struct canfd_frame> mRxFrames;
+	std::vector<struct iovec> mRxIovecs;
+	std::vector<struct mmsghdr> mRxMsgHdrs;
+	std::vector<char> mRxControl;
+	std::vector<CanMessage> mRxMsgs;
+	std::vector<CanMessage> mRxAcks;
+
+	// statistics
+	boost::atomic<uint32_t> mRxFramesReceived;
+	boost::atomic<uint32_t> mRxFramesDropped;
+	boost::atomic<uint32_t> mTxFramesSent;
+	boost::atomic<uint32_t> mTxFramesDropped;
+	boost::atomic<uint32_t> mTxBatchesSent;
+	boost::atomic<uint32_t> mTxBackPressureEvents;
+	boost::atomic<uint32_t> mTxFramesConfirmed;
+	boost::atomic<uint32_t> mErrorFramesReceived;
+
+	// bus state, maintained from error frames (and optionally polled via netlink)
+	boost::atomic<int> mState;
+	boost::atomic<int> mTxErrorCounter;
+	boost::atomic<int> mRxErrorCounter;
+	uint32_t mStateRefreshMs;
 
 	// socket stuff
 	int mNatsock;
-	boost::asio::io_service mIo; ///< Io service object
-	boost::asio::posix::stream_descriptor mStream;
+
+	// io handling, on a private reactor (one thread) or on the shared one
+	bool mUseSharedReactor;
+	std::size_t mReactorThreads;
+	SharedSocketCanReactor mReactor;
+	boost::scoped_ptr<boost::asio::io_service::strand> mStrand; // serializes handlers of this adapter
+	boost::scoped_ptr<boost::asio::posix::stream_descriptor> mStream;
+	boost::scoped_ptr<boost::asio::deadline_timer> mTxRetryTimer;
+	boost::scoped_ptr<boost::asio::deadline_timer> mStateTimer;
+
+	// handlers queued or running, which must complete before closing
+	boost::mutex mHandlerMutex;
+	boost::condition_variable mHandlerCondition;
+	int mNumPendingHandlers;
 
 	LogFile mLogFile;
 };
@@ -112,17 +252,21 @@ SocketCanAdapter::~SocketCanAdapter(){
 }
 
 bool SocketCanAdapter::getFirstChannelName(std::string &aName){
-	return false;
+	return SocketCanAdapter_p::getFirstChannelName(aName);
 }
 
 bool SocketCanAdapter::getNextChannelName(std::string &aName){
-	return false;
+	return SocketCanAdapter_p::getNextChannelName(aName);
 }
 
 bool SocketCanAdapter::setParameter(std::string aKey, std::string aValue){
 	return pimpl->setParameter(aKey, aValue);
 }
 
+bool SocketCanAdapter::getParameter(std::string aKey, std::string &aValue){
+	return pimpl->getParameter(aKey, aValue);
+}
+
 bool SocketCanAdapter::setBaudRate(uint32_t aBaudrate){
 	return pimpl->setBaudRate(aBaudrate);
 }
@@ -147,41 +291,125 @@ bool SocketCanAdapter::goBusOff(){
 	return pimpl->goBusOff();
 }
 
-bool SocketCanAdapter::sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId){
+enum CanAdapter::CanAdapterState SocketCanAdapter::getState(){
+	return pimpl->getState();
+}
+
+void SocketCanAdapter::getErrorCounters(int *aTxErrorCounter, int *aRxErrorCounter){
+	pimpl->getErrorCounters(aTxErrorCounter, aRxErrorCounter);
+}
+
+bool SocketCanAdapter::sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId){
 	return pimpl->sendMessage(aMsg, aTransactionId);
 }
 
+int SocketCanAdapter::sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId){
+	return pimpl->sendMessages(aMsgs, aFirstTransactionId);
+}
+
 int SocketCanAdapter::numReceivedMessagesAvailable(){
 	return pimpl->numReceivedMessagesAvailable();
 }
 
-bool SocketCanAdapter::getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs){
+bool SocketCanAdapter::getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs){
 	return pimpl->getReceivedMessage(aMsg, aTimeoutMs);
 }
 
+int SocketCanAdapter::getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs){
+	return pimpl->getReceivedMessages(aMsgs, aMaxMsgs, aTimeoutMs);
+}
+
+bool SocketCanAdapter::getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+	return pimpl->getReceivedMessageMatching(aMsg, aIdCode, aIdMask, aTimeoutMs);
+}
+
+int SocketCanAdapter::getReceiveEventFd(){
+	return pimpl->getReceiveEventFd();
+}
+
+bool SocketCanAdapter::setReceiveCallback(ReceiveCallback aCallback){
+	return pimpl->setReceiveCallback(aCallback);
+}
+
 int SocketCanAdapter::numSendAcknMessagesAvailable(){
 	return pimpl->numSendAcknMessagesAvailable();
 }
 
-bool SocketCanAdapter::getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
+bool SocketCanAdapter::getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
 	return pimpl->getSendAcknMessage(aMsg, aTransactionId, aTimeoutMs);
 }
 
+int SocketCanAdapter::getSendAcknEventFd(){
+	return pimpl->getSendAcknEventFd();
+}
+
 void SocketCanAdapter::close(){
 	pimpl->close();
 }
 
 SocketCanAdapter_p::SocketCanAdapter_p(std::string aChannelName, uint32_t aBaudrate):
-				mChannelName(aChannelName), mBaudrate(aBaudrate), doIpConfig(false),
-				mThread(), mRxBuf(), mTxBuf(), mTxAckBuf(), mIsOpen(false), mWriteIsIdle(false),
-				mLogFile(), mIo(), mStream(mIo)
+				mIsOpen(false), mRxBuf(), mTxBuf(), mTxAckBuf(),
+				mChannelName(aChannelName), mAutoReopen(false), mLinkListenerId(-1), mLinkState(SocketCanLinkMonitor::LinkUp),
+				mJoinFilters(false), mBaudrate(aBaudrate), doIpConfig(false),
+				mFdEnabled(false), mTxConfirm(false), mDataBitrate(0), mWriteIsIdle(false),
+				mRxBatch(1), mTimeStamping(TimeStampingSoftware),
+				mUseSharedReactor(false), mReactorThreads(0), mNumPendingHandlers(0), mLogFile()
 {
+	mNatsock = -1;
+	mTxCount = 0;
+	mTxPos = 0;
+	mTxRetrying = false;
+	memset(mTxMsgHdrs, 0, sizeof(mTxMsgHdrs));
+	for(int i=0; i<MaxTxBatch; i++){
+		mTxIovecs[i].iov_base = &mTxFrames[i];
+		mTxIovecs[i].iov_len = CAN_MTU;
+		mTxMsgHdrs[i].msg_hdr.msg_iov = &mTxIovecs[i];
+		mTxMsgHdrs[i].msg_hdr.msg_iovlen = 1;
+	}
+	mRxFramesReceived = 0;
+	mRxFramesDropped = 0;
+	mTxFramesSent = 0;
+	mTxFramesDropped = 0;
+	mTxBatchesSent = 0;
+	mTxBackPressureEvents = 0;
+	mTxFramesConfirmed = 0;
+	mErrorFramesReceived = 0;
+	mState = CanAdapter::Closed;
+	mTxErrorCounter = -1;
+	mRxErrorCounter = -1;
+	mStateRefreshMs = 0;
+	mWantOpen = false;
+	mReopenCount = 0;
+
 	for(int i=0; i<NumFilters; i++){
 		mFilter[i].can_id   = 0;
 		mFilter[i].can_mask = 0;
+		mFilterUsed[i] = false;
+		mFilterInverted[i] = false;
 	}
 }
 
+std::size_t SocketCanAdapter_p::mChannelIndex = 0;
+std::vector<std::string> SocketCanAdapter_p::mDetectedChannels;
+
+bool SocketCanAdapter_p::getFirstChannelName(std::string &aName){
+	mChannelIndex = 0;
+	if(!SocketCanLinkMonitor::enumerateInterfaces(mDetectedChannels)){
+		return false;
+	}
+	return(getNextChannelName(aName));
+}
+
+bool SocketCanAdapter_p::getNextChannelName(std::string &aName){
+	if(mChannelIndex < mDetectedChannels.size()){
+		aName = mDetectedChannels[mChannelIndex];
+		mChannelIndex++;
+		return true;
+	}
+	// no new channel found
+	return(false);
+}
+
 SocketCanAdapter_p::~SocketCanAdapter_p(){
 	try {
 		close();
@@ -197,16 +425,223 @@ bool SocketCanAdapter_p::setParameter(std::string aKey, std::string aValue){
 	} else if(aKey == "ipconfig"){
 		doIpConfig = (aValue == "true");
 		return true;
+	} else if(aKey == "rx_batch"){
+		// number of frames read per system call (1: one read per frame)
+		if(mIsOpen){
+			return false;
+		}
+		try {
+			int batch = boost::lexical_cast<int>(aValue);
+			if((batch >= 1) && (batch <= MaxRxBatch)){
+				mRxBatch = batch;
+				return true;
+			}
+		} catch (boost::bad_lexical_cast){
+		}
+		return false;
+	} else if(aKey == "fd"){
+		// enables reception and transmission of CAN FD frames
+		if(mIsOpen){
+			return false;
+		}
+		mFdEnabled = (aValue == "true");
+		return true;
+	} else if(aKey == "rx_mode"){
+		// received frames are buffered, passed to receive callback, or both
+		if(mIsOpen){
+			return false;
+		}
+		return mRxDispatcher.setMode(aValue);
+	} else if(aKey == "shared_reactor"){
+		// serve socket from process-wide pool of io threads, rather than from a dedicated thread
+		if(mIsOpen){
+			return false;
+		}
+		mUseSharedReactor = (aValue == "true");
+		return true;
+	} else if(aKey == "reactor_threads"){
+		// size of shared pool (0: one per core), effective when the pool is first created
+		if(mIsOpen){
+			return false;
+		}
+		try {
+			mReactorThreads = boost::lexical_cast<std::size_t>(aValue);
+			return true;
+		} catch (boost::bad_lexical_cast){
+		}
+		return false;
+	} else if(aKey == "auto_reopen"){
+		// re-open adapter when its interface re-appears (e.g. USB adapter re-plugged) or comes up again
+		if(mIsOpen){
+			return false;
+		}
+		mAutoReopen = (aValue == "true");
+		return true;
+	} else if(aKey == "state_refresh_ms"){
+		// period of polling bus state and error counters via netlink (0: error frames only)
+		try {
+			mStateRefreshMs = boost::lexical_cast<uint32_t>(aValue);
+			return true;
+		} catch (boost::bad_lexical_cast){
+		}
+		return false;
+	} else if(aKey == "tx_confirm"){
+		// acknowledge transmissions once looped back by the interface (i.e. sent on the bus),
+		// rather than once accepted by the socket (default); looped-back frames are subject
+		// to the acceptance filters, which therefore must pass the adapter's own ids
+		if(mIsOpen){
+			return false;
+		}
+		mTxConfirm = (aValue == "true");
+		return true;
+	} else if(aKey == "data_bitrate"){
+		// bitrate of CAN FD data phase (only applied with "ipconfig")
+		if(mIsOpen){
+			return false;
+		}
+		try {
+			mDataBitrate = boost::lexical_cast<uint32_t>(aValue);
+			return true;
+		} catch (boost::bad_lexical_cast){
+		}
+		return false;
+	} else if(boost::starts_with(aKey, "invert_filter_")){
+		// passes all messages except the ones matching filter <n>
+		int fid;
+		try {
+			fid = boost::lexical_cast<int>(aKey.substr(strlen("invert_filter_")));
+		} catch (boost::bad_lexical_cast){
+			return false;
+		}
+		if((fid < 0) || (fid >= NumFilters)){
+			return false;
+		}
+		{
+			boost::mutex::scoped_lock lock(mFilterMutex);
+			mFilterInverted[fid] = (aValue == "true");
+		}
+		return applyFilters();
+	} else if(aKey == "join_filters"){
+		// a message must match all filters, rather than any filter, to be passed
+		{
+			boost::mutex::scoped_lock lock(mFilterMutex);
+			mJoinFilters = (aValue == "true");
+		}
+		return applyFilters();
+	} else if(aKey == "clear_filters"){
+		// removes all filters, all messages are passed
+		{
+			boost::mutex::scoped_lock lock(mFilterMutex);
+			for(int i=0; i<NumFilters; i++){
+				mFilterUsed[i] = false;
+				mFilterInverted[i] = false;
+			}
+		}
+		return applyFilters();
+	} else if(aKey == "timestamping"){
+		// source of receive time-stamps: "off" (user space), "software" (kernel) or "hardware"
+		if(mIsOpen){
+			return false;
+		}
+		if(aValue == "off"){
+			mTimeStamping = TimeStampingOff;
+		} else if(aValue == "software"){
+			mTimeStamping = TimeStampingSoftware;
+		} else if(aValue == "hardware"){
+			mTimeStamping = TimeStampingHardware;
+		} else {
+			return false;
+		}
+		return true;
 	} else {
 		return false;
 	}
 }
 
+bool SocketCanAdapter_p::getParameter(std::string aKey, std::string &aValue){
+	uint32_t value;
+	if(aKey == "rx_batch"){
+		value = mRxBatch;
+	} else if(aKey == "fd"){
+		aValue = mFdEnabled ? "true" : "false";
+		return true;
+	} else if(aKey == "tx_confirm"){
+		aValue = mTxConfirm ? "true" : "false";
+		return true;
+	} else if(aKey == "shared_reactor"){
+		aValue = mUseSharedReactor ? "true" : "false";
+		return true;
+	} else if(aKey == "reactor_threads"){
+		value = mReactor ? mReactor->getNumThreads() : mReactorThreads;
+	} else if(aKey == "data_bitrate"){
+		value = mDataBitrate;
+	} else if(aKey == "join_filters"){
+		aValue = mJoinFilters ? "true" : "false";
+		return true;
+	} else if(aKey == "rx_mode"){
+		aValue = mRxDispatcher.getMode();
+		return true;
+	} else if(aKey == "timestamping"){
+		const char *names[] = {"off", "software", "hardware"};
+		aValue = names[mTimeStamping];
+		return true;
+	} else if(aKey == "rx_frames"){
+		value = mRxFramesReceived;
+	} else if(aKey == "rx_dropped"){
+		value = mRxFramesDropped;
+	} else if(aKey == "tx_frames"){
+		value = mTxFramesSent;
+	} else if(aKey == "tx_dropped"){
+		value = mTxFramesDropped;
+	} else if(aKey == "tx_batches"){
+		value = mTxBatchesSent;
+	} else if(aKey == "tx_backpressure"){
+		value = mTxBackPressureEvents;
+	} else if(aKey == "tx_confirmed"){
+		value = mTxFramesConfirmed;
+	} else if(aKey == "error_frames"){
+		value = mErrorFramesReceived;
+	} else if(aKey == "auto_reopen"){
+		aValue = mAutoReopen ? "true" : "false";
+		return true;
+	} else if(aKey == "reopens"){
+		value = mReopenCount;
+	} else if(aKey == "state_refresh_ms"){
+		value = mStateRefreshMs;
+	} else {
+		return false;
+	}
+	aValue = boost::lexical_cast<std::string>(value);
+	return true;
+}
+
 void SocketCanAdapter_p::close(){
-	if(mIsOpen){
-		mIo.post(boost::bind(&SocketCanAdapter_p::doClose, this));
-		mThread.join();
-		mIo.reset();
+	mWantOpen = false;
+	if(mLinkMonitor){
+		// must not hold mOpenMutex here, as link notifications acquire it
+		mLinkMonitor->removeListener(mLinkListenerId);
+		mLinkMonitor.reset();
+	}
+	boost::mutex::scoped_lock lock(mOpenMutex);
+	shutdown();
+}
+
+void SocketCanAdapter_p::shutdown(){
+	if(mReactor){
+		// also tears down what is left after the socket has been closed due to an error
+		postHandler(&SocketCanAdapter_p::doClose);
+		{
+			boost::mutex::scoped_lock lock(mHandlerMutex);
+			while(mNumPendingHandlers != 0){
+				mHandlerCondition.wait(lock);
+			}
+			// no further handlers can be posted (e.g. by concurrent senders)
+			mStrand.reset();
+		}
+		mTxRetryTimer.reset();
+		mStateTimer.reset();
+		mStream.reset();
+		mReactor.reset(); // joins private io thread
 
 		if(doIpConfig){
 			can_do_stop(mChannelName.c_str()); // no error checking
@@ -234,25 +669,133 @@ int SocketCanAdapter_p::getNumberOfFilters(){
 }
 
 bool SocketCanAdapter_p::setAcceptanceFilter(int fid, uint32_t code, uint32_t mask, bool isExt){
-	if(fid >= NumFilters){
+	if((fid < 0) || (fid >= NumFilters)){
 		return false;
 	}
 
-	if(isExt){
-		mFilter[fid].can_id = (code & CAN_EFF_MASK) | CAN_EFF_FLAG;
-		mFilter[fid].can_mask = CAN_EFF_FLAG | CAN_RTR_FLAG | (mask & CAN_EFF_MASK);
-	} else {
-		mFilter[fid].can_id = (code & CAN_SFF_MASK);
-		mFilter[fid].can_mask =  CAN_EFF_FLAG | CAN_RTR_FLAG | (mask & CAN_SFF_MASK);
+	{
+		boost::mutex::scoped_lock lock(mFilterMutex);
+		if(isExt){
+			mFilter[fid].can_id = (code & CAN_EFF_MASK) | CAN_EFF_FLAG;
+			mFilter[fid].can_mask = CAN_EFF_FLAG | CAN_RTR_FLAG | (mask & CAN_EFF_MASK);
+		} else {
+			mFilter[fid].can_id = (code & CAN_SFF_MASK);
+			mFilter[fid].can_mask =  CAN_EFF_FLAG | CAN_RTR_FLAG | (mask & CAN_SFF_MASK);
+		}
+		mFilterUsed[fid] = true;
+	}
+	// takes effect immediately if the socket is open
+	return applyFilters();
+}
+
+// hands filters to the kernel, which then drops non-matching frames before they reach user space
+bool SocketCanAdapter_p::applyFilters(){
+	boost::mutex::scoped_lock lock(mFilterMutex);
+	if(mNatsock < 0){
+		return true; // applied by open()
+	}
+
+	std::vector<struct can_filter> filters;
+	for(int i=0; i<NumFilters; i++){
+		if(mFilterUsed[i]){
+			struct can_filter f = mFilter[i];
+			if(mFilterInverted[i]){
+				f.can_id |= CAN_INV_FILTER;
+			}
+			filters.push_back(f);
+		}
+	}
+	if(filters.empty()){
+		// no filter configured, pass everything
+		struct can_filter f;
+		f.can_id = 0;
+		f.can_mask = 0;
+		filters.push_back(f);
+	}
+
+	if(::setsockopt(
+			mNatsock,
+			SOL_CAN_RAW,
+			CAN_RAW_FILTER,
+			&filters[0],
+			filters.size()*sizeof(struct can_filter)) < 0)
+	{
+		mLogFile.debugStream() << "Setting filter failed.";
+		return false;
+	}
+
+	int join = mJoinFilters ? 1 : 0;
+	if(::setsockopt(mNatsock, SOL_CAN_RAW, CAN_RAW_JOIN_FILTERS, &join, sizeof(join)) < 0){
+		if(mJoinFilters){
+			mLogFile.debugStream() << "Joining filters failed.";
+			return false;
+		}
+		// older kernels lack CAN_RAW_JOIN_FILTERS, which is fine when not joining
 	}
 	return true;
 }
 
 bool SocketCanAdapter_p::open(){
-	if(mIsOpen){
-		return false;
+	{
+		boost::mutex::scoped_lock lock(mOpenMutex);
+		if(mIsOpen){
+			return false;
+		}
+		// tear down what is left after the socket has been closed due to an error
+		shutdown();
+		if(!doOpen()){
+			return false;
+		}
+		mLinkState = SocketCanLinkMonitor::LinkUp;
+		mWantOpen = true;
+	}
+	if(mAutoReopen && !mLinkMonitor){
+		mLinkMonitor = SocketCanLinkMonitor::getSharedInstance();
+		if(mLinkMonitor){
+			mLinkListenerId = mLinkMonitor->addListener(
+					boost::bind(&SocketCanAdapter_p::linkChanged, this, _1, _2));
+		} else {
+			mLogFile.debugStream() << "Unable to monitor link.";
+		}
+	}
+	return true;
+}
+
+// called from link monitor thread
+void SocketCanAdapter_p::linkChanged(const std::string &aName, SocketCanLinkMonitor::LinkEvent aEvent){
+	if(aName != mChannelName){
+		return;
+	}
+	boost::mutex::scoped_lock lock(mOpenMutex);
+	if(!mWantOpen){
+		return;
+	}
+	SocketCanLinkMonitor::LinkEvent previous = mLinkState;
+	mLinkState = aEvent;
+	if(aEvent == SocketCanLinkMonitor::LinkRemoved){
+		mLogFile.debugStream() << "Interface removed.";
+		shutdown();
+		return;
 	}
 
+	bool reopen;
+	if(doIpConfig){
+		// interface re-appeared and needs to be configured (our own configuration
+		// also produces up/down events, which must be ignored)
+		reopen = (previous == SocketCanLinkMonitor::LinkRemoved);
+	} else {
+		reopen = (aEvent == SocketCanLinkMonitor::LinkUp) && (previous != SocketCanLinkMonitor::LinkUp);
+	}
+	if(reopen){
+		shutdown();
+		if(doOpen()){
+			mReopenCount++;
+		}
+	}
+}
+
+bool SocketCanAdapter_p::doOpen(){
+
 	if(doIpConfig){
 		if(can_set_restart_ms(mChannelName.c_str(), 1000) != 0){
 			mLogFile.debugStream() << "Unable to call can_set_restart_ms().";
@@ -261,7 +804,12 @@ bool SocketCanAdapter_p::open(){
 	}
 
 	if(doIpConfig){
-		if(can_set_bitrate(mChannelName.c_str(), mBaudrate) != 0){
+		if(mFdEnabled && (mDataBitrate != 0)){
+			if(can_set_fd_bitrates(mChannelName.c_str(), mBaudrate, mDataBitrate) != 0){
+				mLogFile.debugStream() << "Unable to call can_set_fd_bitrates().";
+				return false;
+			}
+		} else if(can_set_bitrate(mChannelName.c_str(), mBaudrate) != 0){
 			mLogFile.debugStream() << "Unable to call can_set_bitrate().";
 			return false;
 		}
@@ -275,29 +823,51 @@ bool SocketCanAdapter_p::open(){
 	struct sockaddr_can addr;
 	struct ifreq ifr;
 
-	mNatsock = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+	{
+		boost::mutex::scoped_lock lock(mFilterMutex);
+		mNatsock = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+	}
 	if(mNatsock < 0){
 		mLogFile.debugStream() << "Unable to create socket.";
 		return false;
 	}
 
-	if(::setsockopt(
-			mNatsock,
-			SOL_CAN_RAW,
-			CAN_RAW_FILTER,
-			&mFilter,
-			sizeof(mFilter)) < 0)
-	{
-		mLogFile.debugStream() << "Setting filter failed.";
-		::close(mNatsock);
+	if(!applyFilters()){
+		closeSocket();
 		return false;
 	}
 
+	if(mTxConfirm){
+		// own frames are received with MSG_CONFIRM set once transmitted
+		int on = 1;
+		if(::setsockopt(mNatsock, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &on, sizeof(on)) < 0){
+			mLogFile.debugStream() << "Enabling reception of own messages failed.";
+			closeSocket();
+			return false;
+		}
+	}
+
+	// error frames reporting changes of bus state and error counters
+	can_err_mask_t errMask = CAN_ERR_CRTL | CAN_ERR_BUSOFF | CAN_ERR_RESTARTED | CAN_ERR_CNT;
+	if(::setsockopt(mNatsock, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &errMask, sizeof(errMask)) < 0){
+		// not fatal, state then remains error active
+		mLogFile.debugStream() << "Setting error filter failed.";
+	}
+
+	if(mFdEnabled){
+		int on = 1;
+		if(::setsockopt(mNatsock, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on, sizeof(on)) < 0){
+			mLogFile.debugStream() << "Enabling CAN FD frames failed.";
+			closeSocket();
+			return false;
+		}
+	}
+
 	strcpy(ifr.ifr_name, mChannelName.c_str());
 
 	if(ioctl(mNatsock, SIOCGIFINDEX, &ifr) < 0){
 		mLogFile.debugStream() << "ioctl() failed.";
-		::close(mNatsock);
+		closeSocket();
 		return false;
 	}
 
@@ -305,27 +875,76 @@ bool SocketCanAdapter_p::open(){
 	addr.can_ifindex = ifr.ifr_ifindex;
 	if(bind(mNatsock,(struct sockaddr *)&addr,sizeof(addr)) < 0){
 		mLogFile.debugStream() << "Unable to bind socket.";
-		::close(mNatsock);
+		closeSocket();
 		return false;
 	}
 
-	mStream.assign(mNatsock);
+	if(!enableTimeStamping()){
+		// not fatal, messages are then stamped when they reach user space
+		mLogFile.debugStream() << "Unable to enable time-stamping.";
+	}
 
-	// this gives some work to the io_service before it is started
-	// (without work, io_service::run will return)
-	mIo.post(boost::bind(&SocketCanAdapter_p::doRead, this));
+	if(mUseSharedReactor){
+		mReactor = SocketCanReactor::getSharedInstance(mReactorThreads);
+	} else {
+		mReactor.reset(new SocketCanReactor(1));
+	}
+	mStrand.reset(new boost::asio::io_service::strand(mReactor->getIoService()));
+	mStream.reset(new boost::asio::posix::stream_descriptor(mReactor->getIoService(), mNatsock));
+	mTxRetryTimer.reset(new boost::asio::deadline_timer(mReactor->getIoService()));
+	mStateTimer.reset(new boost::asio::deadline_timer(mReactor->getIoService()));
+
+	mRxFrames.resize(mRxBatch);
+	mRxIovecs.resize(mRxBatch);
+	mRxMsgHdrs.resize(mRxBatch);
+	mRxControl.resize(mRxBatch*RxControlSize);
+	mRxMsgs.resize(mRxBatch);
+	mRxAcks.resize(mRxBatch);
+	memset(&mRxMsgHdrs[0], 0, mRxBatch*sizeof(struct mmsghdr));
+	for(std::size_t i=0; i<mRxBatch; i++){
+		mRxIovecs[i].iov_base = &mRxFrames[i];
+		mRxIovecs[i].iov_len = sizeof(struct canfd_frame);
+		mRxMsgHdrs[i].msg_hdr.msg_iov = &mRxIovecs[i];
+		mRxMsgHdrs[i].msg_hdr.msg_iovlen = 1;
+		if(mTimeStamping != TimeStampingOff){
+			mRxMsgHdrs[i].msg_hdr.msg_control = &mRxControl[i*RxControlSize];
+		}
+	}
 
 	mWriteIsIdle = true;
-	boost::thread t(boost::bind(&boost::asio::io_service::run, &mIo));
-	mThread.swap(t);
+	mTxCount = 0;
+	mTxPos = 0;
+	mTxRetrying = false;
+	mTxInFlight.clear();
+
+	mState = CanAdapter::ErrorActive;
+	mTxErrorCounter = -1;
+	mRxErrorCounter = -1;
+	readLinkState();
 
 	mLogFile.open();
 
 	mIsOpen = true;
+	postHandler(&SocketCanAdapter_p::doRead);
+	if(mStateRefreshMs != 0){
+		postHandler(&SocketCanAdapter_p::startStateRefresh);
+	}
 	return true;
 }
 
 
+enum CanAdapter::CanAdapterState SocketCanAdapter_p::getState(){
+	if(!mIsOpen){
+		return CanAdapter::Closed;
+	}
+	return (enum CanAdapter::CanAdapterState)mState.load();
+}
+
+void SocketCanAdapter_p::getErrorCounters(int *aTxErrorCounter, int *aRxErrorCounter){
+	*aTxErrorCounter = mTxErrorCounter;
+	*aRxErrorCounter = mRxErrorCounter;
+}
+
 bool SocketCanAdapter_p::goBusOn(){
 	if(!mIsOpen){
 		return false;
@@ -340,24 +959,67 @@ bool SocketCanAdapter_p::goBusOff(){
 	return true;
 }
 
-bool SocketCanAdapter_p::sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId){
+bool SocketCanAdapter_p::sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId){
 	if(!mIsOpen){
 		return false;
 	}
 
-	if(!write(aMsg)){
+	CanMessage msg(aMsg);
+	msg.setTransactionId(mTxAckBuf.allocateTransactionIds(1));
+	if(!write(msg)){
 		return false;
 	}
 
-	// transaction ID not yet implemented
 	if(aTransactionId != 0){
-		*aTransactionId = 0;
+		*aTransactionId = msg.getTransactionId();
 	}
-	// acknowledge transmit
-	mTxAckBuf.push(CanMessage::getSharedInstance(aMsg), 0);
 	return true;
 }
 
+int SocketCanAdapter_p::sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId){
+	if(!mIsOpen || aMsgs.empty()){
+		return 0;
+	}
+
+	std::size_t numValid = 0;
+	while((numValid < aMsgs.size()) && isSupported(aMsgs[numValid])){
+		numValid++;
+	}
+	if(numValid == 0){
+		return 0;
+	}
+	uint16_t firstTransactionId = mTxAckBuf.allocateTransactionIds(numValid);
+
+	// tag messages with their transaction id, in chunks to avoid heap allocation
+	CanMessage msgs[MaxTxBatch];
+	std::size_t n = 0;
+	while(n < numValid){
+		std::size_t chunk = std::min<std::size_t>(numValid - n, MaxTxBatch);
+		for(std::size_t i=0; i<chunk; i++){
+			msgs[i] = aMsgs[n + i];
+			msgs[i].setTransactionId(CanAcknBuffer::getTransactionId(firstTransactionId, n + i));
+		}
+		std::size_t numPushed = mTxBuf.pushMany(msgs, chunk, 0);
+		n += numPushed;
+		if(numPushed < chunk){
+			break;
+		}
+	}
+	mTxFramesDropped += (numValid - n);
+	if(n == 0){
+		return 0;
+	}
+	// kick-off transmission (if not already going)
+	if(!postHandler(&SocketCanAdapter_p::doWrite)){
+		return 0; // closing
+	}
+
+	if(aFirstTransactionId != 0){
+		*aFirstTransactionId = firstTransactionId;
+	}
+	return (int)n;
+}
+
 int SocketCanAdapter_p::numReceivedMessagesAvailable(){
 	if(!mIsOpen){
 		return(0);
@@ -365,13 +1027,43 @@ int SocketCanAdapter_p::numReceivedMessagesAvailable(){
 	return mRxBuf.available();
 }
 
-bool SocketCanAdapter_p::getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs){
+bool SocketCanAdapter_p::getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs){
 	if(!mIsOpen){
 		return false;
 	}
 	return mRxBuf.pop(aMsg, aTimeoutMs);
 }
 
+int SocketCanAdapter_p::getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs){
+	if(!mIsOpen || (aMaxMsgs == 0)){
+		aMsgs.clear();
+		return 0;
+	}
+	aMsgs.clear();
+	mRxBuf.popMany(aMsgs, aMaxMsgs, aTimeoutMs);
+	return (int)aMsgs.size();
+}
+
+bool SocketCanAdapter_p::getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs){
+	if(!mIsOpen){
+		return false;
+	}
+	return mRxDispatcher.getMatching(mRxBuf, aMsg, aIdCode, aIdMask, aTimeoutMs);
+}
+
+// descriptor outlives open/close, so that it can stay registered with epoll
+int SocketCanAdapter_p::getReceiveEventFd(){
+	return mRxBuf.getEventFd();
+}
+
+bool SocketCanAdapter_p::setReceiveCallback(CanAdapter::ReceiveCallback aCallback){
+	if(mIsOpen){
+		return false;
+	}
+	mRxDispatcher.setCallback(aCallback);
+	return true;
+}
+
 int SocketCanAdapter_p::numSendAcknMessagesAvailable(){
 	if(!mIsOpen){
 		return(0);
@@ -379,85 +1071,300 @@ int SocketCanAdapter_p::numSendAcknMessagesAvailable(){
 	return mTxAckBuf.available();
 }
 
-bool SocketCanAdapter_p::getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
+bool SocketCanAdapter_p::getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs){
 	if(!mIsOpen){
 		return false;
 	}
-	return mTxAckBuf.pop(aMsg, aTimeoutMs);
+	return mTxAckBuf.pop(aMsg, aTransactionId, aTimeoutMs);
 }
 
-bool SocketCanAdapter_p::write(SharedCanMessage aMsg){
-	if(!mIsOpen){
+int SocketCanAdapter_p::getSendAcknEventFd(){
+	return mTxAckBuf.getEventFd();
+}
+
+bool SocketCanAdapter_p::write(const CanMessage &aMsg){
+	if(!mIsOpen || !isSupported(aMsg)){
 		return false;
 	}
 
 	if(!mTxBuf.push(aMsg, 0)){
+		mTxFramesDropped++;
 		return false;
 	}
 	// kick-off transmission (if not already going)
-	mIo.post(boost::bind(&SocketCanAdapter_p::doWrite, this));
-	return true;
+	return postHandler(&SocketCanAdapter_p::doWrite);
+}
+
+bool SocketCanAdapter_p::isSupported(const CanMessage &aMsg){
+	if(aMsg.isFd()){
+		return mFdEnabled && (aMsg.getLen() <= CANFD_MAX_DLEN);
+	}
+	return (aMsg.getLen() <= CAN_MAX_DLEN);
 }
 
-bool SocketCanAdapter_p::toCanFrame(SharedCanMessage &aMsg, struct can_frame &aFrame){
-	aFrame.can_id  = aMsg->getId();
-	if(aMsg->isExtended()){
+// returns number of bytes to be written (CAN_MTU or CANFD_MTU)
+std::size_t SocketCanAdapter_p::toCanFrame(const CanMessage &aMsg, struct canfd_frame &aFrame){
+	aFrame.can_id  = aMsg.getId();
+	if(aMsg.isExtended()){
 		aFrame.can_id  |= CAN_EFF_FLAG;
 	}
 
-	aFrame.can_dlc = aMsg->getLen();
-	for(int i=0; i<aMsg->getLen(); i++){
-		aFrame.data[i] = aMsg->getData(i);
+	aFrame.flags = 0;
+	aFrame.__res0 = 0;
+	aFrame.__res1 = 0;
+	if(!aMsg.isFd()){
+		// struct can_frame layout (len is can_dlc)
+		aFrame.len = aMsg.getLen();
+		memcpy(aFrame.data, aMsg.getDataPtr(), CAN_MAX_DLEN);
+		return CAN_MTU;
 	}
-	return true;
+
+	if(aMsg.hasBitRateSwitch()){
+		aFrame.flags |= CANFD_BRS;
+	}
+	if(aMsg.hasErrorStateIndicator()){
+		aFrame.flags |= CANFD_ESI;
+	}
+	// message data is padded up to the next valid FD length
+	aFrame.len = CanMessage::getValidFdLen(aMsg.getLen());
+	memcpy(aFrame.data, aMsg.getDataPtr(), aFrame.len);
+	return CANFD_MTU;
 }
 
-bool SocketCanAdapter_p::fromCanFrame(struct can_frame &aFrame, SharedCanMessage &aMsg){
+bool SocketCanAdapter_p::fromCanFrame(const struct canfd_frame &aFrame, std::size_t aMtu, uint64_t aTimeStampNs, CanMessage &aMsg){
 	if((aFrame.can_id & CAN_RTR_FLAG) != 0){
 		return false;
 	} else if((aFrame.can_id & CAN_ERR_FLAG) != 0){
 		return false;
 	} else if((aFrame.can_id & CAN_EFF_FLAG) != 0){
-		aMsg = CanMessage::getSharedInstance(aFrame.can_id & CAN_EFF_MASK, aFrame.can_dlc, true);
+		aMsg = CanMessage(aFrame.can_id & CAN_EFF_MASK, aFrame.len, true, aTimeStampNs);
 	} else {
-		aMsg = CanMessage::getSharedInstance(aFrame.can_id & CAN_SFF_MASK, aFrame.can_dlc, false);
+		aMsg = CanMessage(aFrame.can_id & CAN_SFF_MASK, aFrame.len, false, aTimeStampNs);
 	}
-	for(int i=0; i<aFrame.can_dlc; i++){
-		aMsg->setData(i, aFrame.data[i]);
+	if(aMtu == CANFD_MTU){
+		if(aFrame.len > CANFD_MAX_DLEN){
+			return false;
+		}
+		aMsg.setFd(true, (aFrame.flags & CANFD_BRS) != 0, (aFrame.flags & CANFD_ESI) != 0);
+	} else if(aFrame.len > CAN_MAX_DLEN){
+		return false;
+	}
+	memcpy(aMsg.getDataPtr(), aFrame.data, aFrame.len);
+	return true;
+}
+
+bool SocketCanAdapter_p::enableTimeStamping(){
+	if(mTimeStamping == TimeStampingSoftware){
+		int on = 1;
+		return (::setsockopt(mNatsock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0);
+	} else if(mTimeStamping == TimeStampingHardware){
+		int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+				SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+		return (::setsockopt(mNatsock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0);
 	}
 	return true;
 }
 
+// returns 0 if no kernel time-stamp is attached to the message
+uint64_t SocketCanAdapter_p::getTimeStampNs(struct msghdr &aMsgHdr){
+	const struct timespec *ts = NULL;
+	for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&aMsgHdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&aMsgHdr, cmsg)){
+		if(cmsg->cmsg_level != SOL_SOCKET){
+			continue;
+		}
+		if(cmsg->cmsg_type == SCM_TIMESTAMPNS){
+			ts = (const struct timespec *)CMSG_DATA(cmsg);
+		} else if(cmsg->cmsg_type == SCM_TIMESTAMPING){
+			// [0]: software, [2]: raw hardware time-stamp
+			const struct timespec *stamps = (const struct timespec *)CMSG_DATA(cmsg);
+			ts = ((stamps[2].tv_sec != 0) || (stamps[2].tv_nsec != 0)) ? &stamps[2] : &stamps[0];
+		}
+	}
+	if(ts == NULL){
+		return 0;
+	}
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
 // this method is always executed in the ioservice thread
 void SocketCanAdapter_p::doRead(){
 	if(!mIsOpen){
 		return;
 	}
-	mStream.async_read_some(boost::asio::buffer(&mRxFrame, sizeof(mRxFrame)),
-			boost::bind(&SocketCanAdapter_p::readEnd, this ,
-					boost::ref(mRxFrame),
-		            boost::asio::placeholders::error,
-		            boost::asio::placeholders::bytes_transferred));
+	// wait for readability, frames are then pulled by readBatch()
+	handlerStarted();
+	mStream->async_read_some(boost::asio::null_buffers(),
+			mStrand->wrap(boost::bind(&SocketCanAdapter_p::readBatch, this,
+					boost::asio::placeholders::error)));
 }
 
 // this method is always executed in the ioservice thread
-void SocketCanAdapter_p::readEnd(struct can_frame& aRxFrame,
-		const boost::system::error_code& error, size_t bytes_transferred){
+void SocketCanAdapter_p::readBatch(const boost::system::error_code& error){
+	HandlerScope scope(*this);
 	if(error){
-		mLogFile.debugStream() << "Read end with error";
+		mLogFile.debugStream() << "Read batch with error";
 		if(mIsOpen){
 			doClose();
 		}
-	} else {
-		if(bytes_transferred == sizeof(mRxFrame)){
-			SharedCanMessage m;
-			if(fromCanFrame(aRxFrame, m)){
-				mLogFile.debugStream() << "Read end: " << m;
-				mRxBuf.push(m, 0);
+		return;
+	}
+
+	int numFrames;
+	do {
+		if(mTimeStamping != TimeStampingOff){
+			// control buffer length is updated by the kernel
+			for(std::size_t i=0; i<mRxBatch; i++){
+				mRxMsgHdrs[i].msg_hdr.msg_controllen = RxControlSize;
 			}
 		}
-		doRead();
+		numFrames = ::recvmmsg(mNatsock, &mRxMsgHdrs[0], mRxBatch, MSG_DONTWAIT, NULL);
+		if(numFrames < 0){
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)){
+				break;
+			}
+			mLogFile.debugStream() << "recvmmsg() failed: " << errno;
+			if(mIsOpen){
+				doClose();
+			}
+			return;
+		}
+
+		std::size_t numMsgs = 0;
+		std::size_t numAcks = 0;
+		for(int i=0; i<numFrames; i++){
+			std::size_t mtu = mRxMsgHdrs[i].msg_len;
+			if((mtu != CAN_MTU) && (mtu != CANFD_MTU)){
+				continue;
+			}
+			uint64_t timeStampNs = 0;
+			if(mTimeStamping != TimeStampingOff){
+				timeStampNs = getTimeStampNs(mRxMsgHdrs[i].msg_hdr);
+			}
+			if(timeStampNs == 0){
+				timeStampNs = CanMessage::getCurrentTimeStampNs();
+			}
+			if(mRxFrames[i].can_id & CAN_ERR_FLAG){
+				handleErrorFrame(mRxFrames[i]);
+			} else if(mRxMsgHdrs[i].msg_hdr.msg_flags & MSG_CONFIRM){
+				// loop-back of a frame sent through this socket
+				if(fromCanFrame(mRxFrames[i], mtu, timeStampNs, mRxAcks[numAcks]) && confirm(mRxAcks[numAcks])){
+					numAcks++;
+				}
+			} else if(fromCanFrame(mRxFrames[i], mtu, timeStampNs, mRxMsgs[numMsgs])){
+				numMsgs++;
+			}
+		}
+		if(numAcks > 0){
+			mTxFramesConfirmed += numAcks;
+			mTxAckBuf.pushMany(&mRxAcks[0], numAcks);
+		}
+		if(numMsgs > 0){
+			mLogFile.debugStream() << "Read batch: " << numMsgs << " frames";
+			std::size_t numPushed = mRxDispatcher.dispatch(mRxBuf, &mRxMsgs[0], numMsgs);
+			mRxFramesReceived += numPushed;
+			mRxFramesDropped += (numMsgs - numPushed);
+		}
+	} while(numFrames == (int)mRxBatch);
+
+	doRead();
+}
+
+// matches looped-back frame with oldest in-flight transmission, assigning its transaction id
+// this method is always executed in the ioservice thread
+bool SocketCanAdapter_p::confirm(CanMessage &aMsg){
+	// frames are looped back in order, so normally the first entry matches
+	for(std::size_t i=0; i<mTxInFlight.size(); i++){
+		if(isLoopBackOf(mTxInFlight[i], aMsg)){
+			// acknowledge message as sent (i.e. with original length), at time of loop-back
+			uint64_t timeStampNs = aMsg.getTimeStampNs();
+			aMsg = mTxInFlight[i];
+			aMsg.setTimeStampNs(timeStampNs);
+			// confirmations of preceding frames were lost
+			mTxInFlight.erase(mTxInFlight.begin(), mTxInFlight.begin() + i + 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+// FD frames are looped back with their payload padded to a valid FD length (see toCanFrame())
+bool SocketCanAdapter_p::isLoopBackOf(const CanMessage &aSent, const CanMessage &aLoopedBack){
+	unsigned int len = aSent.isFd() ? CanMessage::getValidFdLen(aSent.getLen()) : aSent.getLen();
+	if((aLoopedBack.getId() != aSent.getId()) || (aLoopedBack.isExtended() != aSent.isExtended()) ||
+			(aLoopedBack.isFd() != aSent.isFd()) || (aLoopedBack.hasBitRateSwitch() != aSent.hasBitRateSwitch()) ||
+			(aLoopedBack.getLen() != len)){
+		return false;
+	}
+	return memcmp(aLoopedBack.getDataPtr(), aSent.getDataPtr(), aSent.getLen()) == 0;
+}
+
+// updates bus state and error counters
+// this method is always executed in the ioservice thread
+void SocketCanAdapter_p::handleErrorFrame(const struct canfd_frame &aFrame){
+	mErrorFramesReceived++;
+	if(aFrame.can_id & CAN_ERR_BUSOFF){
+		mState = CanAdapter::BusOff;
+	} else if(aFrame.can_id & CAN_ERR_RESTARTED){
+		mState = CanAdapter::ErrorActive;
+	} else if(aFrame.can_id & CAN_ERR_CRTL){
+		if(aFrame.data[1] & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE)){
+			mState = CanAdapter::ErrorPassive;
+		} else if(aFrame.data[1] & CAN_ERR_CRTL_ACTIVE){
+			mState = CanAdapter::ErrorActive;
+		}
+	}
+	if(aFrame.can_id & CAN_ERR_CNT){
+		mTxErrorCounter = aFrame.data[6];
+		mRxErrorCounter = aFrame.data[7];
+	}
+}
+
+// reads bus state and error counters via netlink (not supported by all drivers)
+void SocketCanAdapter_p::readLinkState(){
+	int state;
+	if(can_get_state(mChannelName.c_str(), &state) == 0){
+		switch(state){
+		case CAN_STATE_ERROR_ACTIVE:
+		case CAN_STATE_ERROR_WARNING:
+			mState = CanAdapter::ErrorActive;
+			break;
+		case CAN_STATE_ERROR_PASSIVE:
+			mState = CanAdapter::ErrorPassive;
+			break;
+		case CAN_STATE_BUS_OFF:
+			mState = CanAdapter::BusOff;
+			break;
+		default:
+			mState = CanAdapter::Unknown;
+			break;
+		}
+	}
+	struct can_berr_counter bc;
+	if(can_get_berr_counter(mChannelName.c_str(), &bc) == 0){
+		mTxErrorCounter = bc.txerr;
+		mRxErrorCounter = bc.rxerr;
+	}
+}
+
+// this method is always executed in the ioservice thread
+void SocketCanAdapter_p::startStateRefresh(){
+	if(!mIsOpen){
+		return;
+	}
+	handlerStarted();
+	mStateTimer->expires_from_now(boost::posix_time::milliseconds(mStateRefreshMs));
+	mStateTimer->async_wait(mStrand->wrap(boost::bind(&SocketCanAdapter_p::refreshState, this,
+			boost::asio::placeholders::error)));
+}
+
+// this method is always executed in the ioservice thread
+void SocketCanAdapter_p::refreshState(const boost::system::error_code& error){
+	HandlerScope scope(*this);
+	if(error || !mIsOpen){
+		return;
 	}
+	readLinkState();
+	startStateRefresh();
 }
 
 // this method is always executed in the ioservice thread
@@ -466,43 +1373,149 @@ void SocketCanAdapter_p::doWrite(){
 		return;
 	}
 	if(!mWriteIsIdle){
-		// write already in progress
+		// write already in progress (or waiting for socket to become writable)
+		return;
 	}
+	mWriteIsIdle = false;
+	sendPending();
+}
 
-	SharedCanMessage m;
-	if(mTxBuf.pop(m, 0)){
-		if(toCanFrame(m, mTxFrame)){
-			mWriteIsIdle = false;
-			mStream.async_write_some(boost::asio::buffer(&mTxFrame, sizeof(mTxFrame)),
-					boost::bind(&SocketCanAdapter_p::writeEnd, this,
-							boost::ref(mTxFrame),
-							boost::asio::placeholders::error));
+// this method is always executed in the ioservice thread
+void SocketCanAdapter_p::sendPending(){
+	for(;;){
+		if(mTxPos == mTxCount){
+			// coalesce everything queued so far into one batch
+			mTxPos = 0;
+			mTxCount = mTxBuf.popMany(mTxMsgs, MaxTxBatch, 0);
+			if(mTxCount == 0){
+				mWriteIsIdle = true;
+				return;
+			}
+			for(std::size_t i=0; i<mTxCount; i++){
+				mTxIovecs[i].iov_len = toCanFrame(mTxMsgs[i], mTxFrames[i]);
+			}
 		}
+
+		int numSent = ::sendmmsg(mNatsock, &mTxMsgHdrs[mTxPos], mTxCount - mTxPos, MSG_DONTWAIT);
+		if(numSent < 0){
+			if(errno == EINTR){
+				continue;
+			} else if((errno == ENOBUFS) || (errno == EAGAIN) || (errno == EWOULDBLOCK)){
+				// interface queue full, this is back-pressure and not an error
+				mTxBackPressureEvents++;
+				waitWritable(errno == ENOBUFS);
+				return;
+			}
+			mLogFile.debugStream() << "sendmmsg() failed: " << errno;
+			mTxFramesDropped += (mTxCount - mTxPos);
+			mTxPos = mTxCount;
+			mWriteIsIdle = true;
+			if(mIsOpen){
+				doClose();
+			}
+			return;
+		}
+
+		mTxRetrying = false;
+		mTxBatchesSent++;
+		mTxFramesSent += numSent;
+		mLogFile.debugStream() << "Write batch: " << numSent << " frames";
+		if(mTxConfirm){
+			for(int i=0; i<numSent; i++){
+				if(mTxInFlight.size() == MaxTxInFlight){
+					// confirmations are not arriving (e.g. filtered out), give up on oldest
+					mTxInFlight.pop_front();
+				}
+				mTxInFlight.push_back(mTxMsgs[mTxPos + i]);
+			}
+		} else {
+			mTxAckBuf.pushMany(&mTxMsgs[mTxPos], numSent);
+		}
+		mTxPos += numSent;
+	}
+}
+
+// this method is always executed in the ioservice thread
+void SocketCanAdapter_p::waitWritable(bool aNoBufs){
+	if(aNoBufs && mTxRetrying){
+		// socket was reported writable, but the interface queue is still full
+		handlerStarted();
+		mTxRetryTimer->expires_from_now(boost::posix_time::milliseconds((long)TX_RETRY_DELAY_MS));
+		mTxRetryTimer->async_wait(mStrand->wrap(boost::bind(&SocketCanAdapter_p::writeReady, this,
+				boost::asio::placeholders::error)));
+	} else {
+		handlerStarted();
+		mStream->async_write_some(boost::asio::null_buffers(),
+				mStrand->wrap(boost::bind(&SocketCanAdapter_p::writeReady, this,
+						boost::asio::placeholders::error)));
 	}
 }
 
 // this method is always executed in the ioservice thread
-void SocketCanAdapter_p::writeEnd(struct can_frame &aTxFrame, const boost::system::error_code& error){
+void SocketCanAdapter_p::writeReady(const boost::system::error_code& error){
+	HandlerScope scope(*this);
 	if(error){
-		mLogFile.debugStream() << "Write end with error";
+		if(error == boost::asio::error::operation_aborted){
+			return;
+		}
+		mLogFile.debugStream() << "Write ready with error";
 		if(mIsOpen){
 			doClose();
 		}
-	} else {
-		SharedCanMessage m;
-		if(fromCanFrame(aTxFrame, m)){
-			mLogFile.debugStream() << "Write end: " << m;
-			mTxAckBuf.push(m, 0);
-		}
-		mWriteIsIdle = true;
-		doWrite();
+		return;
+	}
+	if(!mIsOpen){
+		return;
 	}
+	mTxRetrying = true;
+	sendPending();
 }
 
 // this method is always executed in the ioservice thread
 void SocketCanAdapter_p::doClose(){
 	mIsOpen = false;
-	mStream.cancel();
-	mStream.close();
-	::close(mNatsock); // TODO: make sure this is correct
+	mTxRetryTimer->cancel();
+	mStateTimer->cancel();
+	boost::mutex::scoped_lock lock(mFilterMutex);
+	if(mNatsock < 0){
+		return; // already closed
+	}
+	mStream->cancel();
+	mStream->close(); // closes mNatsock
+	mNatsock = -1;
+}
+
+// queues handler on the adapter's strand, fails if the adapter has been shut down
+bool SocketCanAdapter_p::postHandler(Handler aHandler){
+	boost::mutex::scoped_lock lock(mHandlerMutex);
+	if(!mStrand){
+		return false;
+	}
+	mNumPendingHandlers++;
+	mStrand->post(boost::bind(&SocketCanAdapter_p::runHandler, this, aHandler));
+	return true;
+}
+
+// this method is always executed in the ioservice thread
+void SocketCanAdapter_p::runHandler(Handler aHandler){
+	HandlerScope scope(*this);
+	(this->*aHandler)();
+}
+
+void SocketCanAdapter_p::handlerStarted(){
+	boost::mutex::scoped_lock lock(mHandlerMutex);
+	mNumPendingHandlers++;
+}
+
+void SocketCanAdapter_p::handlerFinished(){
+	boost::mutex::scoped_lock lock(mHandlerMutex);
+	if(--mNumPendingHandlers == 0){
+		mHandlerCondition.notify_all();
+	}
+}
+
+void SocketCanAdapter_p::closeSocket(){
+	boost::mutex::scoped_lock lock(mFilterMutex);
+	::close(mNatsock);
+	mNatsock = -1;
 }
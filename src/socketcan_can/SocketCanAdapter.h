@@ -53,6 +53,9 @@ public:
 	/* Interface implementation */
 	bool setParameter(std::string aKey, std::string aValue);
 
+	/* Interface implementation */
+	bool getParameter(std::string aKey, std::string &aValue);
+
 	/* Interface implementation */
 	bool setBaudRate(uint32_t aBaudrate);
 
@@ -72,25 +75,43 @@ public:
 	bool goBusOff();
 
 	/* Interface implementation */
-	bool sendMessage(SharedCanMessage aMsg, uint16_t *aTransactionId);
+	bool sendMessage(const CanMessage &aMsg, uint16_t *aTransactionId);
+
+	/* Interface implementation */
+	int sendMessages(const std::vector<CanMessage> &aMsgs, uint16_t *aFirstTransactionId);
 
 	/* Interface implementation */
 	int numReceivedMessagesAvailable();
 
 	/* Interface implementation */
-	bool getReceivedMessage(SharedCanMessage& aMsg, uint32_t aTimeoutMs);
+	bool getReceivedMessage(CanMessage& aMsg, uint32_t aTimeoutMs);
+
+	/* Interface implementation */
+	int getReceivedMessages(std::vector<CanMessage> &aMsgs, std::size_t aMaxMsgs, uint32_t aTimeoutMs);
+
+	/* Interface implementation */
+	bool getReceivedMessageMatching(CanMessage& aMsg, uint32_t aIdCode, uint32_t aIdMask, uint32_t aTimeoutMs);
+
+	/* Interface implementation */
+	int getReceiveEventFd();
+
+	/* Interface implementation */
+	bool setReceiveCallback(ReceiveCallback aCallback);
 
 	/* Interface implementation */
 	int numSendAcknMessagesAvailable();
 
 	/* Interface implementation */
-	bool getSendAcknMessage(SharedCanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+	bool getSendAcknMessage(CanMessage& aMsg, uint16_t aTransactionId, uint32_t aTimeoutMs);
+
+	/* Interface implementation */
+	int getSendAcknEventFd();
 
 	/* Interface implementation */
 	void close();
 
 	/* Interface implementation */
-	enum CanAdapterState getState(){ return CanAdapter::Closed; };
+	enum CanAdapterState getState();
 
 	/* Interface implementation */
 	int getErrorCode(){ return 0; };
@@ -102,10 +123,7 @@ public:
 	}
 
 	/* Interface implementation */
-	void getErrorCounters(int *aTxErrorCounter, int *aRxErrorCounter){
-		*aTxErrorCounter = -1;
-		*aRxErrorCounter = -1;
-	}
+	void getErrorCounters(int *aTxErrorCounter, int *aRxErrorCounter);
 
 private:
 	boost::scoped_ptr<SocketCanAdapter_p> pimpl;
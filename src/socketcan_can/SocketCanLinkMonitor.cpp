@@ -0,0 +1,208 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2017 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include <boost/bind.hpp>
+
+#include "SocketCanLinkMonitor.h"
+
+boost::mutex SocketCanLinkMonitor::mSharedMutex;
+boost::weak_ptr<SocketCanLinkMonitor> SocketCanLinkMonitor::mShared;
+
+namespace {
+
+enum {NetlinkBufferSize = 16384};
+
+// returns name of CAN interface described by RTM_NEWLINK/RTM_DELLINK message (empty if other type)
+std::string getCanInterfaceName(struct nlmsghdr *aHdr){
+	struct ifinfomsg *ifi = (struct ifinfomsg *)NLMSG_DATA(aHdr);
+	if(ifi->ifi_type != ARPHRD_CAN){
+		return "";
+	}
+	int len = aHdr->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+	for(struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)){
+		if(rta->rta_type == IFLA_IFNAME){
+			return std::string((const char *)RTA_DATA(rta));
+		}
+	}
+	return "";
+}
+
+}
+
+bool SocketCanLinkMonitor::enumerateInterfaces(std::vector<std::string> &aNames){
+	aNames.clear();
+
+	int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if(sock < 0){
+		return false;
+	}
+
+	struct {
+		struct nlmsghdr hdr;
+		struct ifinfomsg ifi;
+	} req;
+	memset(&req, 0, sizeof(req));
+	req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req.hdr.nlmsg_type = RTM_GETLINK;
+	req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.hdr.nlmsg_seq = 1;
+	req.ifi.ifi_family = AF_UNSPEC;
+
+	if(send(sock, &req, req.hdr.nlmsg_len, 0) < 0){
+		close(sock);
+		return false;
+	}
+
+	std::vector<char> buf(NetlinkBufferSize);
+	bool done = false;
+	bool ok = true;
+	while(!done){
+		int len = recv(sock, &buf[0], buf.size(), 0);
+		if(len < 0){
+			ok = false;
+			break;
+		}
+		for(struct nlmsghdr *hdr = (struct nlmsghdr *)&buf[0]; NLMSG_OK(hdr, (unsigned int)len); hdr = NLMSG_NEXT(hdr, len)){
+			if(hdr->nlmsg_type == NLMSG_DONE){
+				done = true;
+				break;
+			} else if(hdr->nlmsg_type == NLMSG_ERROR){
+				done = true;
+				ok = false;
+				break;
+			} else if(hdr->nlmsg_type == RTM_NEWLINK){
+				std::string name = getCanInterfaceName(hdr);
+				if(!name.empty()){
+					aNames.push_back(name);
+				}
+			}
+		}
+	}
+	close(sock);
+	return ok;
+}
+
+SharedSocketCanLinkMonitor SocketCanLinkMonitor::getSharedInstance(){
+	boost::mutex::scoped_lock lock(mSharedMutex);
+	SharedSocketCanLinkMonitor monitor = mShared.lock();
+	if(!monitor){
+		monitor.reset(new SocketCanLinkMonitor());
+		if(monitor->mSocket < 0){
+			return SharedSocketCanLinkMonitor();
+		}
+		mShared = monitor;
+	}
+	return monitor;
+}
+
+SocketCanLinkMonitor::SocketCanLinkMonitor():
+	mSocket(-1), mThread(), mListenerMutex(), mListeners(), mNextListenerId(0)
+{
+	mStop = false;
+
+	mSocket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if(mSocket < 0){
+		return;
+	}
+	struct sockaddr_nl addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = RTMGRP_LINK;
+	if(bind(mSocket, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+		close(mSocket);
+		mSocket = -1;
+		return;
+	}
+	boost::thread t(boost::bind(&SocketCanLinkMonitor::run, this));
+	mThread.swap(t);
+}
+
+SocketCanLinkMonitor::~SocketCanLinkMonitor(){
+	mStop = true;
+	if(mThread.joinable()){
+		mThread.join();
+	}
+	if(mSocket >= 0){
+		close(mSocket);
+	}
+}
+
+int SocketCanLinkMonitor::addListener(Listener aListener){
+	boost::mutex::scoped_lock lock(mListenerMutex);
+	int id = mNextListenerId++;
+	mListeners[id] = aListener;
+	return id;
+}
+
+void SocketCanLinkMonitor::removeListener(int aId){
+	boost::mutex::scoped_lock lock(mListenerMutex);
+	mListeners.erase(aId);
+}
+
+void SocketCanLinkMonitor::notify(const std::string &aName, LinkEvent aEvent){
+	boost::mutex::scoped_lock lock(mListenerMutex);
+	for(std::map<int, Listener>::iterator it = mListeners.begin(); it != mListeners.end(); ++it){
+		it->second(aName, aEvent);
+	}
+}
+
+void SocketCanLinkMonitor::run(){
+	std::vector<char> buf(NetlinkBufferSize);
+	struct pollfd pfd;
+	pfd.fd = mSocket;
+	pfd.events = POLLIN;
+	while(!mStop){
+		// poll with timeout, so that stop requests are noticed
+		if(poll(&pfd, 1, POLL_TIMEOUT_MS) <= 0){
+			continue;
+		}
+		int len = recv(mSocket, &buf[0], buf.size(), MSG_DONTWAIT);
+		if(len <= 0){
+			continue;
+		}
+		for(struct nlmsghdr *hdr = (struct nlmsghdr *)&buf[0]; NLMSG_OK(hdr, (unsigned int)len); hdr = NLMSG_NEXT(hdr, len)){
+			if((hdr->nlmsg_type != RTM_NEWLINK) && (hdr->nlmsg_type != RTM_DELLINK)){
+				continue;
+			}
+			std::string name = getCanInterfaceName(hdr);
+			if(name.empty()){
+				continue;
+			}
+			LinkEvent event;
+			if(hdr->nlmsg_type == RTM_DELLINK){
+				event = LinkRemoved;
+			} else if(((struct ifinfomsg *)NLMSG_DATA(hdr))->ifi_flags & IFF_UP){
+				event = LinkUp;
+			} else {
+				event = LinkDown;
+			}
+			notify(name, event);
+		}
+	}
+}
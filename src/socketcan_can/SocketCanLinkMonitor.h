@@ -0,0 +1,96 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2017 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOCKET_CAN_LINK_MONITOR_H_
+#define SOCKET_CAN_LINK_MONITOR_H_
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+class SocketCanLinkMonitor;
+typedef boost::shared_ptr<SocketCanLinkMonitor> SharedSocketCanLinkMonitor;
+
+/**
+ * Discovery of CAN network interfaces, and notification of link changes, via netlink.
+ */
+class SocketCanLinkMonitor : private boost::noncopyable {
+public:
+	enum LinkEvent {
+		LinkRemoved = 0,
+		LinkDown = 1,
+		LinkUp = 2
+	};
+
+	typedef boost::function<void (const std::string &aName, LinkEvent aEvent)> Listener;
+
+	/**
+	 * Lists CAN interfaces (can*, vcan*, ...) by means of a single RTM_GETLINK dump.
+	 * @param aNames vector to which interface names are written
+	 * @return true if successful
+	 */
+	static bool enumerateInterfaces(std::vector<std::string> &aNames);
+
+	/**
+	 * Returns process-wide monitor, which is started on first use and
+	 * stopped when the last user releases it.
+	 */
+	static SharedSocketCanLinkMonitor getSharedInstance();
+
+	~SocketCanLinkMonitor();
+
+	/**
+	 * Registers function called (from the monitor thread) upon link changes of CAN interfaces.
+	 * @return id for removeListener()
+	 */
+	int addListener(Listener aListener);
+
+	/**
+	 * Unregisters listener, waiting for a running notification to complete.
+	 */
+	void removeListener(int aId);
+
+private:
+	static const int POLL_TIMEOUT_MS = 100;
+
+	SocketCanLinkMonitor();
+	void run();
+	void notify(const std::string &aName, LinkEvent aEvent);
+
+	int mSocket;
+	boost::atomic_bool mStop;
+	boost::thread mThread;
+	boost::mutex mListenerMutex;
+	std::map<int, Listener> mListeners;
+	int mNextListenerId;
+
+	static boost::mutex mSharedMutex;
+	static boost::weak_ptr<SocketCanLinkMonitor> mShared;
+};
+
+#endif /* SOCKET_CAN_LINK_MONITOR_H_ */
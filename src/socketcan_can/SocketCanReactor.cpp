@@ -0,0 +1,57 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2017 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/bind.hpp>
+
+#include "SocketCanReactor.h"
+
+boost::mutex SocketCanReactor::mSharedMutex;
+boost::weak_ptr<SocketCanReactor> SocketCanReactor::mShared;
+
+SocketCanReactor::SocketCanReactor(std::size_t aNumThreads):
+	mNumThreads(aNumThreads), mIo(), mWork(new boost::asio::io_service::work(mIo)), mThreads()
+{
+	if(mNumThreads == 0){
+		mNumThreads = boost::thread::hardware_concurrency();
+		if(mNumThreads == 0){
+			mNumThreads = 1;
+		}
+	}
+	for(std::size_t i=0; i<mNumThreads; i++){
+		mThreads.create_thread(boost::bind(&boost::asio::io_service::run, &mIo));
+	}
+}
+
+SocketCanReactor::~SocketCanReactor(){
+	// adapters have completed all their handlers by now
+	mWork.reset();
+	mIo.stop();
+	mThreads.join_all();
+}
+
+SharedSocketCanReactor SocketCanReactor::getSharedInstance(std::size_t aNumThreads){
+	boost::mutex::scoped_lock lock(mSharedMutex);
+	SharedSocketCanReactor reactor = mShared.lock();
+	if(!reactor){
+		reactor.reset(new SocketCanReactor(aNumThreads));
+		mShared = reactor;
+	}
+	return reactor;
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2017 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOCKET_CAN_REACTOR_H_
+#define SOCKET_CAN_REACTOR_H_
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/asio.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+class SocketCanReactor;
+typedef boost::shared_ptr<SocketCanReactor> SharedSocketCanReactor;
+
+/**
+ * Pool of threads running an io_service, on which adapters register their sockets.
+ * Adapters either own a private reactor with a single thread, or share the
+ * process-wide instance, in which case their handlers are serialized by a strand.
+ */
+class SocketCanReactor : private boost::noncopyable {
+public:
+	SocketCanReactor(std::size_t aNumThreads);
+	~SocketCanReactor();
+
+	/**
+	 * Returns process-wide reactor, which is created on first use and
+	 * destroyed when the last adapter releases it.
+	 * @param aNumThreads number of io threads (0: one per core), only
+	 * used when the reactor is created
+	 */
+	static SharedSocketCanReactor getSharedInstance(std::size_t aNumThreads);
+
+	boost::asio::io_service &getIoService(){ return mIo; };
+	std::size_t getNumThreads() const { return mNumThreads; };
+
+private:
+	std::size_t mNumThreads;
+	boost::asio::io_service mIo;
+	boost::scoped_ptr<boost::asio::io_service::work> mWork; // keeps threads running while idle
+	boost::thread_group mThreads;
+
+	static boost::mutex mSharedMutex;
+	static boost::weak_ptr<SocketCanReactor> mShared;
+};
+
+#endif /* SOCKET_CAN_REACTOR_H_ */
@@ -84,6 +84,7 @@ struct req_info {
 	__u32 restart_ms;
 	struct can_ctrlmode *ctrlmode;
 	struct can_bittiming *bittiming;
+	struct can_bittiming *data_bittiming;
 };
 
 /**
@@ -648,6 +649,12 @@ static int do_set_nl_link(int fd, __u8 if_state, const char *name,
 				  sizeof(struct can_bittiming));
 		}
 
+		if (req_info->data_bittiming != NULL) {
+			addattr_l(&req.n, 1024, IFLA_CAN_DATA_BITTIMING,
+				  req_info->data_bittiming,
+				  sizeof(struct can_bittiming));
+		}
+
 		if (req_info->ctrlmode != NULL) {
 			addattr_l(&req.n, 1024, IFLA_CAN_CTRLMODE,
 				  req_info->ctrlmode,
@@ -945,6 +952,44 @@ int can_set_bitrate(const char *name, __u32 bitrate)
 	return can_set_bittiming(name, &bt);
 }
 
+/**
+ * @ingroup extern
+ * can_set_fd_bitrates - enable CAN FD and setup nominal and data bitrates.
+ *
+ * @param name name of the can device. This is the netdev name, as ifconfig -a shows
+ * in your system. usually it contains prefix "can" and the numer of the can
+ * line. e.g. "can0"
+ * @param bitrate bitrate of the arbitration phase
+ * @param data_bitrate bitrate of the data phase
+ *
+ * The bit timings are calculated by the driver, the same way as for
+ * can_set_bitrate. The device must be stopped.
+ *
+ * @return 0 if success
+ * @return -1 if failed
+ */
+
+int can_set_fd_bitrates(const char *name, __u32 bitrate, __u32 data_bitrate)
+{
+	struct can_bittiming bt, dbt;
+	struct can_ctrlmode cm;
+
+	memset(&bt, 0, sizeof(bt));
+	bt.bitrate = bitrate;
+	memset(&dbt, 0, sizeof(dbt));
+	dbt.bitrate = data_bitrate;
+	cm.mask = CAN_CTRLMODE_FD;
+	cm.flags = CAN_CTRLMODE_FD;
+
+	struct req_info req_info = {
+		.ctrlmode = &cm,
+		.bittiming = &bt,
+		.data_bittiming = &dbt,
+	};
+
+	return set_link(name, 0, &req_info);
+}
+
 /**
  * @ingroup extern
  * can_set_bitrate_samplepoint - setup the bitrate.
@@ -43,6 +43,7 @@ int can_set_bittiming(const char *name, struct can_bittiming *bt);
 int can_set_ctrlmode(const char *name, struct can_ctrlmode *cm);
 int can_set_bitrate(const char *name, __u32 bitrate);
 int can_set_bitrate_samplepoint(const char *name, __u32 bitrate, __u32 sample_point);
+int can_set_fd_bitrates(const char *name, __u32 bitrate, __u32 data_bitrate);
 
 int can_get_restart_ms(const char *name, __u32 *restart_ms);
 int can_get_bittiming(const char *name, struct can_bittiming *bt);
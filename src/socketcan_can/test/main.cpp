@@ -0,0 +1,182 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2018 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * SocketCAN receive throughput benchmark.
+ *
+ * Floods a (virtual) CAN interface from a raw socket and counts the frames
+ * delivered by a SocketCanAdapter, once per requested "rx_batch" setting.
+ * Beforehand, checks that a CAN FD frame is confirmed once transmitted.
+ *
+ * Setup:
+ *   sudo modprobe vcan
+ *   sudo ip link add dev vcan0 type vcan
+ *   sudo ip link set vcan0 mtu 72
+ *   sudo ip link set up vcan0
+ *
+ * Usage: TestSocketCanBenchmark [interface] [frames] [rx_batch...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "../SocketCanAdapter.h"
+
+static int openRawSocket(const std::string &aIfName){
+	int s = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+	if(s < 0){
+		return -1;
+	}
+	struct ifreq ifr;
+	strncpy(ifr.ifr_name, aIfName.c_str(), IFNAMSIZ-1);
+	ifr.ifr_name[IFNAMSIZ-1] = 0;
+	if(ioctl(s, SIOCGIFINDEX, &ifr) < 0){
+		close(s);
+		return -1;
+	}
+	struct sockaddr_can addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	if(bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+		close(s);
+		return -1;
+	}
+	return s;
+}
+
+static void flood(int aSocket, uint32_t aNumFrames){
+	struct can_frame frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.can_dlc = 8;
+	for(uint32_t i=0; i<aNumFrames; i++){
+		frame.can_id = i & CAN_SFF_MASK;
+		memcpy(frame.data, &i, sizeof(i));
+		while(write(aSocket, &frame, sizeof(frame)) != sizeof(frame)){
+			// tx queue full
+			boost::this_thread::yield();
+		}
+	}
+}
+
+// sends CAN FD frame whose length is padded on the wire, and waits for its confirmation
+static bool checkFdConfirm(const std::string &aIfName){
+	SocketCanAdapter can(aIfName);
+	if(!can.setParameter("fd", "true") || !can.setParameter("tx_confirm", "true") || !can.open()){
+		std::cout << "Unable to open " << aIfName << " for CAN FD" << std::endl;
+		return false;
+	}
+
+	CanMessage msg(0x123, 10);
+	msg.setFd(true, true);
+	for(unsigned int i=0; i<msg.getLen(); i++){
+		msg.setData(i, i);
+	}
+	uint16_t tid = 0;
+	CanMessage ack;
+	bool ok = can.sendMessage(msg, &tid) && can.getSendAcknMessage(ack, tid, 1000);
+	can.close();
+
+	ok = ok && (ack.getTransactionId() == tid) && (ack == msg);
+	std::cout << "CAN FD confirmation (" << msg.getLen() << " bytes): " << (ok ? "ok" : "FAILED") << std::endl;
+	return ok;
+}
+
+static bool run(const std::string &aIfName, uint32_t aNumFrames, int aRxBatch){
+	SocketCanAdapter can(aIfName);
+	char batch[16];
+	snprintf(batch, sizeof(batch), "%d", aRxBatch);
+	if(!can.setParameter("rx_batch", batch) || !can.open()){
+		std::cout << "Unable to open " << aIfName << std::endl;
+		return false;
+	}
+
+	int tx = openRawSocket(aIfName);
+	if(tx < 0){
+		std::cout << "Unable to open raw socket on " << aIfName << std::endl;
+		return false;
+	}
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+	boost::thread sender(flood, tx, aNumFrames);
+
+	std::vector<CanMessage> msgs;
+	uint32_t received = 0;
+	while(received < aNumFrames){
+		if(can.getReceivedMessages(msgs, 256, 500) == 0){
+			// no more frames, remainder has been dropped
+			break;
+		}
+		received += msgs.size();
+	}
+	sender.join();
+	boost::posix_time::time_duration d = boost::posix_time::microsec_clock::local_time() - start;
+
+	std::string rxDropped;
+	can.getParameter("rx_dropped", rxDropped);
+
+	close(tx);
+	can.close();
+
+	double secs = d.total_microseconds() / 1.0e6;
+	std::cout << "rx_batch " << aRxBatch << ": "
+			<< received << "/" << aNumFrames << " frames received ("
+			<< (aNumFrames - received) << " lost, "
+			<< rxDropped << " dropped by adapter), "
+			<< (uint32_t)(received / secs) << " frames/s" << std::endl;
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	std::string ifName = (argc > 1) ? argv[1] : "vcan0";
+	uint32_t numFrames = (argc > 2) ? atoi(argv[2]) : 1000000;
+
+	std::vector<int> batches;
+	for(int i=3; i<argc; i++){
+		batches.push_back(atoi(argv[i]));
+	}
+	if(batches.empty()){
+		batches.push_back(1);
+		batches.push_back(64);
+	}
+
+	if(!checkFdConfirm(ifName)){
+		return EXIT_FAILURE;
+	}
+
+	for(std::size_t i=0; i<batches.size(); i++){
+		if(!run(ifName, numFrames, batches[i])){
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -75,12 +75,15 @@ void AsyncSerial::open(const std::string& devname, unsigned int baud_rate,
 //    EscapeCommFunction( handle, CLRRTS );
 #endif
 
+    //Port is now open, must be set before doRead() can run,
+    //or the io_service runs out of work and the thread exits
+    pimpl->open = true;
+
     //This gives some work to the io_service before it is started
     pimpl->io.post(boost::bind(&AsyncSerial::doRead, this));
 
     boost::thread t(boost::bind(&boost::asio::io_service::run, &pimpl->io));
     pimpl->backgroundThread.swap(t);
-    pimpl->open = true; //Port is now open
 }
 
 bool AsyncSerial::setBaudrate(unsigned int baud_rate) const
@@ -23,6 +23,7 @@
 #include <stdint.h>
 
 #include <queue>
+#include <vector>
 #include <boost/thread/thread.hpp>
 
 #pragma once
@@ -63,6 +64,65 @@ public:
 	    return true;
 	}
 
+	/**
+	 * Push up to aCount entries with a single lock acquisition and wakeup.
+	 * @return number of entries pushed
+	 */
+	std::size_t pushMany(const M *msgs, std::size_t aCount, uint32_t aTimeoutMs){
+	    boost::mutex::scoped_lock lock(mBoostMutex);
+	    std::size_t n = 0;
+	    while((n < aCount) && (mQueue.size() < mMaxEntries)){
+	    	mQueue.push(msgs[n++]);
+	    }
+	    lock.unlock();
+	    if(n > 0){
+	    	mBoostNotifier.notify_all();
+	    }
+	    return n;
+	}
+
+	/**
+	 * Pop up to aMax entries with a single lock acquisition.
+	 * Blocks until at least one entry is available, or the timeout expires.
+	 * @return number of entries popped
+	 */
+	std::size_t popMany(M *msgs, std::size_t aMax, uint32_t aTimeoutMs){
+	    boost::mutex::scoped_lock lock(mBoostMutex);
+	    if((aMax == 0) || !mBoostNotifier.timed_wait(lock, boost::posix_time::milliseconds(aTimeoutMs),
+	    		boost::bind(&BlockingBufferWithTimeout::isNotEmpty, this))){
+	    	return 0;
+	    }
+
+	    std::size_t n = 0;
+	    while((n < aMax) && !mQueue.empty()){
+	    	msgs[n++] = mQueue.front();
+	    	mQueue.pop();
+	    }
+	    return n;
+	}
+
+	/**
+	 * Pop up to aMax entries with a single lock acquisition, appending them to msgs.
+	 * Only the entries popped are copied, so that a vector can be reused
+	 * without constructing aMax entries per call.
+	 * @return number of entries popped
+	 */
+	std::size_t popMany(std::vector<M> &msgs, std::size_t aMax, uint32_t aTimeoutMs){
+	    boost::mutex::scoped_lock lock(mBoostMutex);
+	    if((aMax == 0) || !mBoostNotifier.timed_wait(lock, boost::posix_time::milliseconds(aTimeoutMs),
+	    		boost::bind(&BlockingBufferWithTimeout::isNotEmpty, this))){
+	    	return 0;
+	    }
+
+	    std::size_t n = (aMax < mQueue.size()) ? aMax : mQueue.size();
+	    msgs.reserve(msgs.size() + n);
+	    for(std::size_t i=0; i<n; i++){
+	    	msgs.push_back(mQueue.front());
+	    	mQueue.pop();
+	    }
+	    return n;
+	}
+
 	int32_t  available() const{
 	    boost::mutex::scoped_lock lock(mBoostMutex);
 	    return mQueue.size();
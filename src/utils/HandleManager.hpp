@@ -22,77 +22,156 @@
 
 #include <stdint.h>
 
-#include <queue>
-#include <vector>
-
+#include <deque>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Thread-safe table mapping integer handles to shared instances.
+ *
+ * A handle combines a slot index (lower bits) with the generation of the
+ * slot (upper bits). The generation is bumped whenever a handle is released,
+ * so that stale handles never alias an instance assigned to the slot later
+ * on; slots whose generations are exhausted are retired.
+ *
+ * Lookups take no mutex: the slot tag is checked before and after the
+ * instance is copied by means of the atomic shared_ptr accessors. Since a
+ * copy is returned, an instance remains alive while in use, even if its
+ * handle is released concurrently. Assigning and releasing handles is
+ * serialized by a mutex.
+ *
+ * M must be a boost::shared_ptr.
+ */
 
 template<class M>
 class HandleManager {
 public:
 	HandleManager(M aNullHandle, std::size_t aMaxHandles = 1024) :
-		mInstances(), mRecycledHandles(), mNextFreshHandle(1), mMaxHandles(aMaxHandles) {
-		mInstances.push_back(aNullHandle);
+		mNullInstance(aNullHandle), mIndexBits(indexBits(aMaxHandles)),
+		mMaxGeneration((1u << (HandleBits - mIndexBits)) - 1), mMaxHandles(aMaxHandles),
+		mSlots(new Slot[aMaxHandles]), mNextFreshIndex(1), mRecycledIndices(), mMutex() {
 	}
 
 	~HandleManager(){};
 
+	/**
+	 * @return handle, 0 if table is full
+	 */
 	std::size_t assignToHandle(M aInstance){
-		std::size_t handle = 0;
-		if(mRecycledHandles.size() != 0){
-			handle = mRecycledHandles.front();
-			mRecycledHandles.pop();
-			mInstances[handle] = aInstance;
+		boost::mutex::scoped_lock lock(mMutex);
+		std::size_t index = 0;
+		if(mRecycledIndices.size() != 0){
+			index = mRecycledIndices.front();
+			mRecycledIndices.pop_front();
+		} else if(mNextFreshIndex < mMaxHandles){
+			index = mNextFreshIndex;
+			mNextFreshIndex++;
 		} else {
-			if(mNextFreshHandle < mMaxHandles){
-				handle = mNextFreshHandle;
-				mNextFreshHandle++;
-				mInstances.push_back(aInstance);
-			}
+			return 0;
 		}
-		return handle;
+		Slot &slot = mSlots[index];
+		uint32_t generation = slot.mTag.load(boost::memory_order_relaxed) >> 1;
+		boost::atomic_store(&slot.mInstance, aInstance);
+		slot.mTag.store((generation << 1) | 1, boost::memory_order_release);
+		return ((std::size_t)generation << mIndexBits) | index;
 	}
 
 	void releaseHandle(std::size_t aHandle){
-		if((aHandle+1) == mNextFreshHandle){
-			mInstances.pop_back();
-			mNextFreshHandle--;
-		} else {
-			mInstances[aHandle] = mInstances[0];
-			mRecycledHandles.push(aHandle);
-		}
+		boost::mutex::scoped_lock lock(mMutex);
+		release(aHandle);
 	}
 
 	void releaseAllHandles(){
-		mInstances.clear();
-		std::queue<std::size_t> empty;
-		std::swap(mRecycledHandles, empty);
-		mNextFreshHandle = 0;
+		boost::mutex::scoped_lock lock(mMutex);
+		for(std::size_t index=1; index<mNextFreshIndex; index++){
+			uint32_t tag = mSlots[index].mTag.load(boost::memory_order_relaxed);
+			if((tag & 1) != 0){
+				release(((std::size_t)(tag >> 1) << mIndexBits) | index);
+			}
+		}
 	}
 
-	M& operator [](std::size_t aHandle){
-		if(aHandle < mNextFreshHandle){
-			return mInstances[aHandle];
-		} else {
-			return mInstances[0];
+	/**
+	 * @return instance associated with handle, null instance if handle is not valid
+	 */
+	M operator [](std::size_t aHandle) const {
+		const Slot *slot = lookup(aHandle);
+		if(slot == NULL){
+			return mNullInstance;
+		}
+		M instance = boost::atomic_load(&slot->mInstance);
+		if(slot->mTag.load(boost::memory_order_acquire) != validTag(aHandle)){
+			// released while copying
+			return mNullInstance;
 		}
+		return instance;
 	}
 
-	bool isValid(std::size_t aHandle){
-		if(aHandle < mNextFreshHandle){
-			return (mInstances[aHandle] != mInstances[0]);
-		} else {
-			return false;
+	bool isValid(std::size_t aHandle) const {
+		return (lookup(aHandle) != NULL);
+	}
+
+private:
+	enum {
+		// handles are passed around as positive int
+		HandleBits = 31
+	};
+
+	struct Slot {
+		Slot() : mTag(0), mInstance() {};
+		// generation in upper bits, bit 0 set while assigned
+		boost::atomic<uint32_t> mTag;
+		M mInstance;
+	};
+
+	static std::size_t indexBits(std::size_t aMaxHandles){
+		std::size_t bits = 1;
+		while(((std::size_t)1 << bits) < aMaxHandles){
+			bits++;
 		}
+		return bits;
 	}
 
-	std::size_t nextFreshHandle(){
-		return mNextFreshHandle;
+	uint32_t validTag(std::size_t aHandle) const {
+		return (uint32_t)(((aHandle >> mIndexBits) << 1) | 1);
 	}
 
-private:
-	std::size_t mNextFreshHandle;
+	const Slot *lookup(std::size_t aHandle) const {
+		std::size_t index = aHandle & (((std::size_t)1 << mIndexBits) - 1);
+		if((index == 0) || (index >= mMaxHandles) || (aHandle >> HandleBits) != 0){
+			return NULL;
+		}
+		const Slot *slot = &mSlots[index];
+		if(slot->mTag.load(boost::memory_order_acquire) != validTag(aHandle)){
+			return NULL;
+		}
+		return slot;
+	}
+
+	// must be called with mMutex held
+	void release(std::size_t aHandle){
+		Slot *slot = const_cast<Slot *>(lookup(aHandle));
+		if(slot == NULL){
+			return;
+		}
+		// invalidate handle before dropping the instance
+		uint32_t generation = (slot->mTag.load(boost::memory_order_relaxed) >> 1) + 1;
+		slot->mTag.store(generation << 1, boost::memory_order_release);
+		boost::atomic_store(&slot->mInstance, M());
+		if(generation <= mMaxGeneration){
+			mRecycledIndices.push_back(aHandle & (((std::size_t)1 << mIndexBits) - 1));
+		}
+	}
+
+	M mNullInstance;
+	std::size_t mIndexBits;
+	uint32_t mMaxGeneration;
 	std::size_t mMaxHandles;
-	std::vector<M> mInstances;
-	std::queue<std::size_t> mRecycledHandles;
+	boost::scoped_array<Slot> mSlots;
+	std::size_t mNextFreshIndex;
+	std::deque<std::size_t> mRecycledIndices;
+	boost::mutex mMutex;
 };
 
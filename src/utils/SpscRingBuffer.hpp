@@ -0,0 +1,319 @@
+/*
+ * This file is part of a CODESKIN library that is being made available
+ * as open source under the GNU Lesser General Public License.
+ *
+ * Copyright 2005-2017 by CodeSkin LLC, www.codeskin.com.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * ERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+
+#ifdef SCONS_TARGET_LINUX
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
+
+/**
+ * Lock-free single-producer/single-consumer ring buffer with timed-out blocking.
+ *
+ * Interchangeable with BlockingBufferWithTimeout. The producer never takes
+ * a lock, unless a consumer is actually waiting for data (eventcount), in
+ * which case it wakes it up. Consumers are serialized by a mutex, so that
+ * occasional concurrent readers remain safe.
+ *
+ * Only one thread may push into the buffer.
+ *
+ * On Linux, an eventfd can be obtained that is readable whenever the buffer
+ * is not empty, so that consumers can wait on several buffers (and other
+ * descriptors) at once. It is only maintained once it has been requested.
+ */
+
+template<class M>
+class SpscRingBuffer {
+	enum {CacheLineSize = 64};
+
+public:
+	SpscRingBuffer(std::size_t aMaxEntries = 1024) :
+			mHead(0), mTail(0), mWaiters(0), mEventFd(-1), mSignaled(false), mMutex(), mNotifier(),
+			mCapacity(roundUpToPowerOfTwo(aMaxEntries)), mSlots(mCapacity) {
+	}
+
+	~SpscRingBuffer(){
+#ifdef SCONS_TARGET_LINUX
+		if(mEventFd >= 0){
+			::close(mEventFd);
+		}
+#endif
+	};
+
+	bool push(M msg,  uint32_t aTimeoutMs){
+		std::size_t tail = mTail.load(boost::memory_order_relaxed);
+		if((tail - mHead.load(boost::memory_order_acquire)) >= mCapacity){
+			return false;
+		}
+		mSlots[tail & (mCapacity-1)] = msg;
+		mTail.store(tail+1, boost::memory_order_release);
+		wakeConsumer();
+		signalEvent();
+		return true;
+	}
+
+	bool pop(M &msg,  uint32_t aTimeoutMs){
+		boost::mutex::scoped_lock lock(mMutex);
+		if(!waitNotEmpty(lock, aTimeoutMs)){
+			return false;
+		}
+		std::size_t head = mHead.load(boost::memory_order_relaxed);
+		msg = mSlots[head & (mCapacity-1)];
+		mHead.store(head+1, boost::memory_order_release);
+		resetEvent();
+		return true;
+	}
+
+	/**
+	 * Push up to aCount entries, waking the consumer at most once.
+	 * @return number of entries pushed
+	 */
+	std::size_t pushMany(const M *msgs, std::size_t aCount, uint32_t aTimeoutMs){
+		std::size_t tail = mTail.load(boost::memory_order_relaxed);
+		std::size_t space = mCapacity - (tail - mHead.load(boost::memory_order_acquire));
+		std::size_t n = (aCount < space) ? aCount : space;
+		for(std::size_t i=0; i<n; i++){
+			mSlots[(tail+i) & (mCapacity-1)] = msgs[i];
+		}
+		if(n > 0){
+			mTail.store(tail+n, boost::memory_order_release);
+			wakeConsumer();
+			signalEvent();
+		}
+		return n;
+	}
+
+	/**
+	 * Pop up to aMax entries.
+	 * Blocks until at least one entry is available, or the timeout expires.
+	 * @return number of entries popped
+	 */
+	std::size_t popMany(M *msgs, std::size_t aMax, uint32_t aTimeoutMs){
+		if(aMax == 0){
+			return 0;
+		}
+		boost::mutex::scoped_lock lock(mMutex);
+		if(!waitNotEmpty(lock, aTimeoutMs)){
+			return 0;
+		}
+		std::size_t head = mHead.load(boost::memory_order_relaxed);
+		std::size_t count = mTail.load(boost::memory_order_acquire) - head;
+		std::size_t n = (aMax < count) ? aMax : count;
+		for(std::size_t i=0; i<n; i++){
+			msgs[i] = mSlots[(head+i) & (mCapacity-1)];
+		}
+		mHead.store(head+n, boost::memory_order_release);
+		resetEvent();
+		return n;
+	}
+
+	/**
+	 * Pop up to aMax entries, appending them to msgs.
+	 * Only the entries popped are copied, so that a vector can be reused
+	 * without constructing aMax entries per call.
+	 * @return number of entries popped
+	 */
+	std::size_t popMany(std::vector<M> &msgs, std::size_t aMax, uint32_t aTimeoutMs){
+		if(aMax == 0){
+			return 0;
+		}
+		boost::mutex::scoped_lock lock(mMutex);
+		if(!waitNotEmpty(lock, aTimeoutMs)){
+			return 0;
+		}
+		std::size_t head = mHead.load(boost::memory_order_relaxed);
+		std::size_t count = mTail.load(boost::memory_order_acquire) - head;
+		std::size_t n = (aMax < count) ? aMax : count;
+		msgs.reserve(msgs.size() + n);
+		for(std::size_t i=0; i<n; i++){
+			msgs.push_back(mSlots[(head+i) & (mCapacity-1)]);
+		}
+		mHead.store(head+n, boost::memory_order_release);
+		resetEvent();
+		return n;
+	}
+
+	/**
+	 * Pop first entry satisfying predicate, without blocking.
+	 * The order of the remaining entries is preserved.
+	 * @return true if an entry was found
+	 */
+	template<class Pred>
+	bool popFirst(M &msg, Pred aPred){
+		boost::mutex::scoped_lock lock(mMutex);
+		std::size_t head = mHead.load(boost::memory_order_relaxed);
+		std::size_t tail = mTail.load(boost::memory_order_acquire);
+		for(std::size_t i=head; i!=tail; i++){
+			if(aPred(mSlots[i & (mCapacity-1)])){
+				msg = mSlots[i & (mCapacity-1)];
+				// close the gap by moving the preceding entries up, the producer never touches them
+				for(std::size_t j=i; j!=head; j--){
+					mSlots[j & (mCapacity-1)] = mSlots[(j-1) & (mCapacity-1)];
+				}
+				mHead.store(head+1, boost::memory_order_release);
+				resetEvent();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	int32_t  available() const{
+		return (int32_t)(mTail.load(boost::memory_order_acquire) - mHead.load(boost::memory_order_acquire));
+	}
+
+	void clear(){
+		boost::mutex::scoped_lock lock(mMutex);
+		mHead.store(mTail.load(boost::memory_order_acquire), boost::memory_order_release);
+		resetEvent();
+	}
+
+	/**
+	 * Returns descriptor which is readable while the buffer is not empty.
+	 * The descriptor remains owned by the buffer.
+	 * @return file descriptor, -1 if not supported
+	 */
+	int getEventFd(){
+#ifdef SCONS_TARGET_LINUX
+		boost::mutex::scoped_lock lock(mMutex);
+		if(mEventFd < 0){
+			int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if(fd < 0){
+				return -1;
+			}
+			mEventFd.store(fd, boost::memory_order_seq_cst);
+			// entries pushed before the descriptor was published
+			if(isNotEmpty() && !mSignaled.exchange(true)){
+				writeEvent();
+			}
+		}
+		return mEventFd;
+#else
+		return -1;
+#endif
+	}
+
+private:
+	static std::size_t roundUpToPowerOfTwo(std::size_t aValue){
+		std::size_t v = 1;
+		while(v < aValue){
+			v <<= 1;
+		}
+		return v;
+	}
+
+	// only to be called by consumer (with mutex held)
+	bool isNotEmpty() const{
+		// order against the waiter registration in waitNotEmpty()
+		boost::atomic_thread_fence(boost::memory_order_seq_cst);
+		return mHead.load(boost::memory_order_relaxed) != mTail.load(boost::memory_order_acquire);
+	}
+
+	// only to be called by consumer (with mutex held)
+	bool waitNotEmpty(boost::mutex::scoped_lock &lock, uint32_t aTimeoutMs){
+		if(isNotEmpty()){
+			return true;
+		}
+		if(aTimeoutMs == 0){
+			return false;
+		}
+
+		boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(aTimeoutMs);
+		mWaiters.fetch_add(1, boost::memory_order_seq_cst);
+		bool notEmpty = false;
+		while(!(notEmpty = isNotEmpty())){
+			if(!mNotifier.timed_wait(lock, deadline)){
+				notEmpty = isNotEmpty();
+				break;
+			}
+		}
+		mWaiters.fetch_sub(1, boost::memory_order_relaxed);
+		return notEmpty;
+	}
+
+	// only to be called by producer
+	void wakeConsumer(){
+		boost::atomic_thread_fence(boost::memory_order_seq_cst);
+		if(mWaiters.load(boost::memory_order_relaxed) != 0){
+			// taking the mutex guarantees that the waiter is blocked on the notifier
+			{
+				boost::mutex::scoped_lock lock(mMutex);
+			}
+			mNotifier.notify_all();
+		}
+	}
+
+	// only to be called by producer
+	void signalEvent(){
+		if(mEventFd.load(boost::memory_order_acquire) < 0){
+			return;
+		}
+		if(!mSignaled.exchange(true)){
+			writeEvent();
+		}
+	}
+
+	// only to be called by consumer (with mutex held)
+	void resetEvent(){
+		if((mEventFd.load(boost::memory_order_relaxed) < 0) || isNotEmpty()){
+			return;
+		}
+#ifdef SCONS_TARGET_LINUX
+		eventfd_t value;
+		eventfd_read(mEventFd, &value);
+#endif
+		// the producer may have pushed while the flag was still set, in which case
+		// it did not signal; the exchange synchronizes with the producer
+		mSignaled.exchange(false);
+		if(isNotEmpty() && !mSignaled.exchange(true)){
+			writeEvent();
+		}
+	}
+
+	void writeEvent(){
+#ifdef SCONS_TARGET_LINUX
+		eventfd_write(mEventFd, 1);
+#endif
+	}
+
+	// consumer index, producer index and waiter count on separate cache lines
+	boost::atomic<std::size_t> mHead;
+	char mPad0[CacheLineSize - sizeof(boost::atomic<std::size_t>)];
+	boost::atomic<std::size_t> mTail;
+	char mPad1[CacheLineSize - sizeof(boost::atomic<std::size_t>)];
+	boost::atomic<uint32_t> mWaiters;
+	char mPad2[CacheLineSize - sizeof(boost::atomic<uint32_t>)];
+
+	// readiness descriptor, and whether it is currently signaled
+	boost::atomic<int> mEventFd;
+	boost::atomic<bool> mSignaled;
+
+	mutable boost::mutex mMutex;
+	boost::condition_variable mNotifier;
+	std::size_t mCapacity;
+	std::vector<M> mSlots;
+};